@@ -0,0 +1,326 @@
+/**
+ * @file bench_heap.c
+ * @brief Heap profile of the ESP-IDF port over sustained measurement loops.
+ *
+ * Runs the real ESP-IDF port (port/htu21d_port_esp.c) on host stand-ins of
+ * the legacy I2C driver and FreeRTOS (idf_shim/), against the simulated
+ * sensor, for millions of read_value() calls. Every malloc()/calloc()/
+ * realloc()/free() made by the driver and the I2C driver is interposed with
+ * `-Wl,--wrap` and served from a small first-fit heap model, so the numbers
+ * are deterministic and show fragmentation the way a long-running device
+ * would build it up:
+ *
+ * - allocations and bytes per sample made on behalf of the driver
+ * - peak heap held by the driver at any one time
+ * - free heap, largest free block, fragmentation and minimum free heap
+ *
+ * While the driver blocks in i2c_master_cmd_begin() or vTaskDelay(), an
+ * "application" keeps replacing a pool of long-lived blocks of random size,
+ * like other tasks on a device do (disable with `--no-app`).
+ *
+ * Usage: bench_heap [--samples N] [--mode fixed|polling|hold] [--no-app]
+ *                   [--max-allocs-per-sample X]
+ *
+ * With `--max-allocs-per-sample` it exits non-zero when the driver allocates
+ * more often than that, which ctest uses to keep the hot path heap free.
+ *
+ * On a device the same numbers come from the IDF heap tracing API, see
+ * examples/heap_profile_htu21d.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "htu21d.h"
+#include "idf_shim.h"
+#include "sim_bus.h"
+
+#define HEAP_SIZE       (32 * 1024) /**< Heap model size, a typical free DRAM budget for a driver and its neighbours. */
+#define HEAP_ALIGN      16
+#define APP_BLOCKS      32          /**< Long-lived application blocks kept on the heap. */
+#define APP_MIN_SIZE    16
+#define APP_MAX_SIZE    256
+#define APP_CHURN       4           /**< The application replaces a block every APP_CHURN times the driver blocks. */
+#define REPORTS         10
+
+/**
+ * @brief Who a heap block was allocated for.
+ */
+typedef enum {
+    OWNER_FREE = 0,
+    OWNER_DRIVER,
+    OWNER_APP,
+} owner_t;
+
+/**
+ * @brief Header in front of every block of the heap model.
+ */
+typedef struct {
+    size_t size;    /**< Block size including this header. */
+    size_t owner;   /**< One of #owner_t. */
+} block_t;
+
+_Static_assert(sizeof(block_t) % HEAP_ALIGN == 0, "block header breaks alignment");
+
+/**
+ * @brief Heap model counters.
+ */
+typedef struct {
+    uint64_t driver_allocations;
+    uint64_t driver_bytes;
+    size_t driver_live;
+    size_t driver_peak;
+    size_t free_bytes;
+    size_t min_free_bytes;
+    unsigned failed;
+} heap_stats_t;
+
+static _Alignas(HEAP_ALIGN) uint8_t _heap[HEAP_SIZE];
+static heap_stats_t _stats;
+
+static void *_app_blocks[APP_BLOCKS];
+static uint32_t _rng = 12345;
+static unsigned _blocked_calls;
+
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static void heap_init(void)
+{
+    block_t *block = (block_t *) _heap;
+    block->size = HEAP_SIZE;
+    block->owner = OWNER_FREE;
+    _stats = (heap_stats_t) {
+        .free_bytes = HEAP_SIZE,
+        .min_free_bytes = HEAP_SIZE,
+    };
+}
+
+static block_t *next_block(block_t *block)
+{
+    uint8_t *next = (uint8_t *) block + block->size;
+    return next < _heap + HEAP_SIZE ? (block_t *) next : NULL;
+}
+
+static bool in_heap(const void *ptr)
+{
+    return (const uint8_t *) ptr >= _heap && (const uint8_t *) ptr < _heap + HEAP_SIZE;
+}
+
+/**
+ * @brief First fit, merging runs of free blocks on the way and splitting the
+ * block it takes.
+ *
+ * The owner is an argument rather than a global switched around the
+ * application's malloc()/free() calls: the compiler treats those as builtins
+ * that read no globals and may drop such stores at -O2.
+ */
+static void *heap_alloc(size_t size, owner_t owner)
+{
+    size_t needed = (sizeof(block_t) + size + HEAP_ALIGN - 1) & ~(size_t)(HEAP_ALIGN - 1);
+
+    for (block_t *block = (block_t *) _heap; block != NULL; block = next_block(block)) {
+        if (block->owner != OWNER_FREE) {
+            continue;
+        }
+        for (block_t *next = next_block(block); next != NULL && next->owner == OWNER_FREE; next = next_block(block)) {
+            block->size += next->size;
+        }
+        if (block->size < needed) {
+            continue;
+        }
+        if (block->size - needed >= sizeof(block_t) + HEAP_ALIGN) {
+            block_t *rest = (block_t *)((uint8_t *) block + needed);
+            rest->size = block->size - needed;
+            rest->owner = OWNER_FREE;
+            block->size = needed;
+        }
+        block->owner = owner;
+        _stats.free_bytes -= block->size;
+        if (_stats.free_bytes < _stats.min_free_bytes) {
+            _stats.min_free_bytes = _stats.free_bytes;
+        }
+        if (owner == OWNER_DRIVER) {
+            _stats.driver_allocations++;
+            _stats.driver_bytes += size;
+            _stats.driver_live += block->size;
+            if (_stats.driver_live > _stats.driver_peak) {
+                _stats.driver_peak = _stats.driver_live;
+            }
+        }
+        return block + 1;
+    }
+    _stats.failed++;
+    return NULL;
+}
+
+static void heap_free(void *ptr)
+{
+    block_t *block = (block_t *) ptr - 1;
+
+    if (block->owner == OWNER_DRIVER) {
+        _stats.driver_live -= block->size;
+    }
+    _stats.free_bytes += block->size;
+    block->owner = OWNER_FREE;
+}
+
+static size_t largest_free_block(void)
+{
+    size_t largest = 0, run = 0;
+
+    for (block_t *block = (block_t *) _heap; block != NULL; block = next_block(block)) {
+        run = block->owner == OWNER_FREE ? run + block->size : 0;
+        if (run > largest) {
+            largest = run;
+        }
+    }
+    return largest > sizeof(block_t) ? largest - sizeof(block_t) : 0;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    return heap_alloc(size, OWNER_DRIVER);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = heap_alloc(count * size, OWNER_DRIVER);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (ptr != NULL && !in_heap(ptr)) {
+        return __real_realloc(ptr, size);
+    }
+    void *moved = heap_alloc(size, OWNER_DRIVER);
+    if (moved != NULL && ptr != NULL) {
+        size_t old_size = ((block_t *) ptr - 1)->size - sizeof(block_t);
+        memcpy(moved, ptr, old_size < size ? old_size : size);
+        heap_free(ptr);
+    }
+    return moved;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    if (!in_heap(ptr)) {
+        __real_free(ptr);
+        return;
+    }
+    heap_free(ptr);
+}
+
+static uint32_t next_random(void)
+{
+    _rng = _rng * 1664525 + 1013904223;
+    return _rng >> 8;
+}
+
+// other tasks running while the driver's task is blocked
+static void on_blocked(void)
+{
+    if (++_blocked_calls % APP_CHURN != 0) {
+        return;
+    }
+    int slot = next_random() % APP_BLOCKS;
+    if (_app_blocks[slot] != NULL) {
+        heap_free(_app_blocks[slot]);
+    }
+    _app_blocks[slot] = heap_alloc(APP_MIN_SIZE + next_random() % (APP_MAX_SIZE - APP_MIN_SIZE + 1), OWNER_APP);
+}
+
+static void report(uint64_t samples)
+{
+    size_t largest = largest_free_block();
+
+    printf("%12llu %10.1f %13.2f %12.1f %8zu %8zu %8zu %7.1f%%\n", (unsigned long long) samples,
+           sim_now_us() / 3.6e9, samples ? (double) _stats.driver_allocations / samples : 0.0,
+           samples ? (double) _stats.driver_bytes / samples : 0.0, _stats.driver_peak,
+           _stats.free_bytes, largest,
+           _stats.free_bytes ? 100.0 * (1.0 - (double) largest / _stats.free_bytes) : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t samples = 1000000;
+    htu21d_read_mode_t mode = HTU21D_READ_MODE_FIXED_WAIT;
+    bool app = true;
+    double max_allocs = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            mode = strcmp(name, "polling") == 0 ? HTU21D_READ_MODE_POLLING
+                   : strcmp(name, "hold") == 0 ? HTU21D_READ_MODE_HOLD : HTU21D_READ_MODE_FIXED_WAIT;
+        } else if (strcmp(argv[i], "--no-app") == 0) {
+            app = false;
+        } else if (strcmp(argv[i], "--max-allocs-per-sample") == 0 && i + 1 < argc) {
+            max_allocs = strtod(argv[++i], NULL);
+        } else {
+            fprintf(stderr, "Usage: %s [--samples N] [--mode fixed|polling|hold] [--no-app] "
+                    "[--max-allocs-per-sample X]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    heap_init();
+    sim_reset();
+    sim_add_sensor(I2C_NUM_0, HTU21D_NO_MUX, 0);
+    if (app) {
+        idf_shim_set_blocked_hook(on_blocked);
+    }
+
+    if (htu21d_init(I2C_NUM_0, 1, 2, GPIO_PULLUP_ENABLE, GPIO_PULLUP_ENABLE) != HTU21D_ERR_OK) {
+        fprintf(stderr, "htu21d_init() failed\n");
+        return EXIT_FAILURE;
+    }
+    htu21d_get_default_dev()->read_mode = mode;
+
+    printf("HTU21D heap profile (ESP-IDF legacy I2C port, %d byte heap model, %s)\n\n", HEAP_SIZE,
+           app ? "with application churn" : "driver only");
+    printf("%12s %10s %13s %12s %8s %8s %8s %8s\n", "Samples", "Uptime h", "Allocs/sample", "Bytes/sample",
+           "Peak", "Free", "Largest", "Frag");
+
+    uint64_t next_report = samples / REPORTS;
+    for (uint64_t sample = 1; sample <= samples; sample++) {
+        uint8_t command = sample % 2 ? TRIGGER_TEMP_MEASURE_NOHOLD : TRIGGER_HUMD_MEASURE_NOHOLD;
+        if (read_value(command) == 0) {
+            fprintf(stderr, "read_value() failed at sample %llu\n", (unsigned long long) sample);
+            return EXIT_FAILURE;
+        }
+        if (sample == next_report || sample == samples) {
+            report(sample);
+            next_report += samples / REPORTS;
+        }
+    }
+
+    double allocs_per_sample = samples ? (double) _stats.driver_allocations / samples : 0.0;
+    printf("\nDriver: %.2f allocations per sample, peak %zu bytes. Minimum free heap: %zu bytes, "
+           "failed allocations: %u\n", allocs_per_sample, _stats.driver_peak, _stats.min_free_bytes,
+           _stats.failed);
+
+    if (max_allocs >= 0 && allocs_per_sample > max_allocs) {
+        fprintf(stderr, "The driver allocates %.2f times per sample, over the limit of %.2f\n",
+                allocs_per_sample, max_allocs);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
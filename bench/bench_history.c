@@ -0,0 +1,221 @@
+/**
+ * @file bench_history.c
+ * @brief Time window queries: columnar raw history vs. an array of float
+ * structs.
+ *
+ * Fills a day of 1 Hz samples and answers "min/max/mean over the last N
+ * minutes" queries two ways:
+ *
+ * - columnar: htu21d_history_find() + htu21d_history_stats() on raw codes,
+ *             converted once per result
+ * - structs:  the usual design, an array of converted float records, scanned
+ *             for the time window and copied out, then reduced in floats
+ *
+ * and reports memory per sample and time per query for several window
+ * lengths. Both answers are compared, so the benchmark doubles as a check.
+ * Then it times htu21d_history_downsample() of the whole history to a
+ * display's worth of points.
+ *
+ * Usage: bench_history [--samples N] [--queries N] [--points N]
+ *
+ * Exits non-zero if the two answers differ or downsampling returns the wrong
+ * number of points.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d_history.h"
+
+/**
+ * @brief A converted sample, as kept by the struct based design.
+ */
+typedef struct {
+    uint64_t timestamp_us;
+    float temperature;
+    float humidity;
+    float compensated_humidity;
+    float dew_point;
+    uint8_t flags;
+} fat_sample_t;
+
+typedef struct {
+    float min_temperature, max_temperature, mean_temperature;
+    float min_humidity, max_humidity, mean_humidity;
+} window_t;
+
+static volatile float _sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static window_t query_columns(const htu21d_history_t *history, uint64_t from_us, uint64_t to_us)
+{
+    htu21d_history_stats_t stats;
+    uint32_t count;
+    uint32_t first = htu21d_history_find(history, from_us, to_us, &count);
+
+    htu21d_history_stats(history, first, count, 0, 0, &stats);
+    return (window_t) {
+        htu21d_raw_to_temperature(stats.min_temperature), htu21d_raw_to_temperature(stats.max_temperature),
+        htu21d_raw_to_temperature(stats.mean_temperature), htu21d_raw_to_humidity(stats.min_humidity),
+        htu21d_raw_to_humidity(stats.max_humidity), htu21d_raw_to_humidity(stats.mean_humidity),
+    };
+}
+
+static window_t query_structs(const fat_sample_t *samples, size_t n, fat_sample_t *copy, uint64_t from_us,
+                              uint64_t to_us)
+{
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (samples[i].timestamp_us >= from_us && samples[i].timestamp_us < to_us) {
+            copy[found++] = samples[i];
+        }
+    }
+
+    window_t w = {INFINITY, -INFINITY, 0, INFINITY, -INFINITY, 0};
+    double sum_t = 0, sum_rh = 0;
+    for (size_t i = 0; i < found; i++) {
+        w.min_temperature = fminf(w.min_temperature, copy[i].temperature);
+        w.max_temperature = fmaxf(w.max_temperature, copy[i].temperature);
+        w.min_humidity = fminf(w.min_humidity, copy[i].humidity);
+        w.max_humidity = fmaxf(w.max_humidity, copy[i].humidity);
+        sum_t += copy[i].temperature;
+        sum_rh += copy[i].humidity;
+    }
+    w.mean_temperature = found ? (float)(sum_t / found) : 0;
+    w.mean_humidity = found ? (float)(sum_rh / found) : 0;
+    return w;
+}
+
+static bool same(const window_t *a, const window_t *b)
+{
+    // the columnar mean is rounded to a whole code: 0.003 degC / 0.002 %RH
+    return fabsf(a->min_temperature - b->min_temperature) < 0.001F &&
+           fabsf(a->max_temperature - b->max_temperature) < 0.001F &&
+           fabsf(a->mean_temperature - b->mean_temperature) < 0.01F &&
+           fabsf(a->min_humidity - b->min_humidity) < 0.001F &&
+           fabsf(a->max_humidity - b->max_humidity) < 0.001F &&
+           fabsf(a->mean_humidity - b->mean_humidity) < 0.01F;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = 86400;
+    int queries = 200;
+    uint32_t points = 320;
+    static const uint32_t windows_min[] = {1, 10, 60, 360};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            queries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+            points = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--samples N] [--queries N] [--points N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (samples < 2 || queries < 1 || points < 3) {
+        return EXIT_FAILURE;
+    }
+
+    uint64_t *timestamps = malloc(samples * sizeof(uint64_t));
+    uint16_t *raw_t = malloc(samples * sizeof(uint16_t));
+    uint16_t *raw_rh = malloc(samples * sizeof(uint16_t));
+    uint8_t *flags = malloc(samples);
+    fat_sample_t *fat = malloc(samples * sizeof(fat_sample_t));
+    fat_sample_t *copy = malloc(samples * sizeof(fat_sample_t));
+    htu21d_history_t history;
+    if (timestamps == NULL || raw_t == NULL || raw_rh == NULL || flags == NULL || fat == NULL || copy == NULL ||
+            htu21d_history_init(&history, samples, timestamps, raw_t, raw_rh, flags) != HTU21D_ERR_OK) {
+        return EXIT_FAILURE;
+    }
+
+    // a day at 1 Hz, pushed 10 % past capacity so the ring has wrapped
+    uint32_t total = samples + samples / 10;
+    for (uint32_t s = 0; s < total; s++) {
+        htu21d_sample_t sample;
+        uint16_t code_t = (uint16_t)(0x6000 + (s * 37) % 0x800) & 0xFFFC;
+        uint16_t code_rh = (uint16_t)(0x7000 + (s * 53) % 0x1000) & 0xFFFC;
+        htu21d_sample_from_raw(&sample, code_t, code_rh, 0x00, HTU21D_SAMPLE_CRC_OK, s * 1000000ULL);
+        htu21d_history_push(&history, &sample);
+        fat[s % samples] = (fat_sample_t) {
+            .timestamp_us = sample.timestamp_us,
+            .temperature = htu21d_sample_temperature(&sample),
+            .humidity = htu21d_sample_humidity(&sample),
+            .flags = sample.flags,
+        };
+    }
+    uint64_t end_us = total * 1000000ULL;
+
+    printf("HTU21D history, %u samples (1 Hz), %d queries per window\n\n", samples, queries);
+    printf("Memory per sample: columnar %zu bytes, structs %zu bytes\n\n",
+           sizeof(uint64_t) + 2 * sizeof(uint16_t) + sizeof(uint8_t), sizeof(fat_sample_t));
+    printf("%-10s %16s %16s %9s\n", "Window", "Columnar us/q", "Structs us/q", "Speedup");
+
+    int failed = 0;
+    for (size_t w = 0; w < sizeof(windows_min) / sizeof(windows_min[0]); w++) {
+        uint64_t window_us = windows_min[w] * 60000000ULL;
+        uint64_t from_us = window_us < end_us ? end_us - window_us : 0;
+        window_t a = {0}, b = {0};
+
+        uint64_t start = now_ns();
+        for (int q = 0; q < queries; q++) {
+            a = query_columns(&history, from_us, end_us);
+            _sink = a.mean_temperature;
+        }
+        uint64_t columnar_ns = now_ns() - start;
+
+        start = now_ns();
+        for (int q = 0; q < queries; q++) {
+            b = query_structs(fat, samples, copy, from_us, end_us);
+            _sink = b.mean_temperature;
+        }
+        uint64_t structs_ns = now_ns() - start;
+
+        printf("%-7u min %16.2f %16.2f %8.1fx\n", windows_min[w], columnar_ns / 1e3 / queries,
+               structs_ns / 1e3 / queries, (double) structs_ns / columnar_ns);
+        if (!same(&a, &b)) {
+            fprintf(stderr, "%u min window: columnar and struct answers differ\n", windows_min[w]);
+            failed = 1;
+        }
+    }
+
+    uint32_t *indices = malloc(points * sizeof(uint32_t));
+    if (indices == NULL) {
+        return EXIT_FAILURE;
+    }
+    uint64_t start = now_ns();
+    uint32_t picked = 0;
+    for (int q = 0; q < queries; q++) {
+        picked = htu21d_history_downsample(&history, 0, history.count, HTU21D_HISTORY_TEMPERATURE, indices, points);
+    }
+    double downsample_ms = (now_ns() - start) / 1e6 / queries;
+    printf("\nDownsample %u samples to %u points (LTTB): %.3f ms\n", history.count, picked, downsample_ms);
+    uint32_t expected = history.count < points ? history.count : points;
+    if (picked != expected) {
+        fprintf(stderr, "Downsampling returned %u points, expected %u\n", picked, expected);
+        failed = 1;
+    }
+    free(indices);
+
+    free(timestamps);
+    free(raw_t);
+    free(raw_rh);
+    free(flags);
+    free(fat);
+    free(copy);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
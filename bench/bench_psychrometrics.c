@@ -0,0 +1,148 @@
+/**
+ * @file bench_psychrometrics.c
+ * @brief Humidity ratio + enthalpy per reading: batch kernel vs. the usual
+ * per-quantity code.
+ *
+ * Computes humidity ratio and enthalpy for a block of sensors three ways:
+ *
+ * - naive:  humidity ratio and enthalpy each evaluate the saturation pressure
+ *           themselves, with powf() as htu21d_compute_partial_pressure() did
+ * - scalar: htu21d_compute_moist_air() per reading
+ * - batch:  htu21d_compute_moist_air_batch() over the block
+ *
+ * and reports ns per reading. The results are compared, so the benchmark
+ * doubles as a check.
+ *
+ * Usage: bench_psychrometrics [--sensors N] [--rounds N]
+ *
+ * Exits non-zero if the kernels disagree with the naive code by more than
+ * 0.01 %.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d.h"
+
+#define PRESSURE_KPA    101.325F
+
+static volatile float _sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static float naive_vapor_kpa(float temperature, float relative_humidity)
+{
+    float mmhg = powf(10.0F, 8.1332F - 1762.39F / (temperature + 235.66F));
+    return relative_humidity / 100.0F * mmhg * 0.133322387F;
+}
+
+static float naive_humidity_ratio(float temperature, float relative_humidity)
+{
+    float vapor = naive_vapor_kpa(temperature, relative_humidity);
+    return 0.621945F * vapor / (PRESSURE_KPA - vapor);
+}
+
+static float naive_enthalpy(float temperature, float relative_humidity)
+{
+    float ratio = naive_humidity_ratio(temperature, relative_humidity);
+    return 1.006F * temperature + ratio * (2501.0F + 1.86F * temperature);
+}
+
+static bool agree(float a, float b)
+{
+    return fabsf(a - b) <= 1e-4F * fabsf(b) + 1e-6F;
+}
+
+int main(int argc, char **argv)
+{
+    int sensors = 64, rounds = 20000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc) {
+            sensors = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--sensors N] [--rounds N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (sensors < 1 || rounds < 1) {
+        return EXIT_FAILURE;
+    }
+
+    float *temperature = malloc(sensors * sizeof(float));
+    float *humidity = malloc(sensors * sizeof(float));
+    htu21d_moist_air_t *naive = malloc(sensors * sizeof(htu21d_moist_air_t));
+    htu21d_moist_air_t *scalar = malloc(sensors * sizeof(htu21d_moist_air_t));
+    htu21d_moist_air_t *batch = malloc(sensors * sizeof(htu21d_moist_air_t));
+    if (temperature == NULL || humidity == NULL || naive == NULL || scalar == NULL || batch == NULL) {
+        return EXIT_FAILURE;
+    }
+    for (int s = 0; s < sensors; s++) {
+        temperature[s] = -10.0F + 50.0F * s / sensors;
+        humidity[s] = 20.0F + 60.0F * ((s * 37) % sensors) / sensors;
+    }
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int s = 0; s < sensors; s++) {
+            naive[s].humidity_ratio = naive_humidity_ratio(temperature[s], humidity[s]);
+            naive[s].enthalpy = naive_enthalpy(temperature[s], humidity[s]);
+        }
+        _sink = naive[r % sensors].enthalpy;
+    }
+    uint64_t naive_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int s = 0; s < sensors; s++) {
+            htu21d_compute_moist_air(temperature[s], humidity[s], PRESSURE_KPA, &scalar[s]);
+        }
+        _sink = scalar[r % sensors].enthalpy;
+    }
+    uint64_t scalar_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        htu21d_compute_moist_air_batch(temperature, humidity, PRESSURE_KPA, sensors, batch);
+        _sink = batch[r % sensors].enthalpy;
+    }
+    uint64_t batch_ns = now_ns() - start;
+
+    double readings = (double) sensors * rounds;
+    printf("Humidity ratio + enthalpy, %d sensors x %d rounds\n\n", sensors, rounds);
+    printf("%-8s %12s %9s\n", "Kernel", "ns/reading", "Speedup");
+    printf("%-8s %12.1f %8.1fx\n", "naive", naive_ns / readings, 1.0);
+    printf("%-8s %12.1f %8.1fx\n", "scalar", scalar_ns / readings, (double) naive_ns / scalar_ns);
+    printf("%-8s %12.1f %8.1fx\n", "batch", batch_ns / readings, (double) naive_ns / batch_ns);
+
+    int failed = 0;
+    for (int s = 0; s < sensors; s++) {
+        if (!agree(scalar[s].humidity_ratio, naive[s].humidity_ratio) ||
+                !agree(scalar[s].enthalpy, naive[s].enthalpy) ||
+                !agree(batch[s].humidity_ratio, naive[s].humidity_ratio) ||
+                !agree(batch[s].enthalpy, naive[s].enthalpy)) {
+            fprintf(stderr, "%.1f degC / %.1f %%RH: kernels disagree with the naive code\n", temperature[s],
+                    humidity[s]);
+            failed = 1;
+        }
+    }
+
+    free(temperature);
+    free(humidity);
+    free(naive);
+    free(scalar);
+    free(batch);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
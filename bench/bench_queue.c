@@ -0,0 +1,256 @@
+/**
+ * @file bench_queue.c
+ * @brief Many producers feeding one consumer: lock-free queue vs. a mutex.
+ *
+ * 1..32 producer threads, standing in for sensor tasks, each push a run of
+ * sample records while one consumer thread, the logger, drains them. The same
+ * load runs through:
+ *
+ * - lock-free: htu21d_queue_push()/htu21d_queue_pop()
+ * - mutex:     a ring of the same size behind one pthread mutex, copying each
+ *              record under the lock like a mutex-guarded RTOS queue does
+ *
+ * and reports throughput, time per record and how often a push found the
+ * queue full (the producer then yields and tries again, so every record gets
+ * through). Every record carries its producer and a per-producer sequence
+ * number, so the consumer also checks that nothing is lost, duplicated or
+ * reordered.
+ *
+ * Usage: bench_queue [--records N] [--capacity N]
+ *
+ * Exits non-zero if a queue loses, duplicates or reorders a record.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d_queue.h"
+
+#define MAX_PRODUCERS 32
+
+/**
+ * @brief The mutex baseline: same ring, one lock.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    htu21d_record_t *records;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t overflows;
+} mutex_queue_t;
+
+typedef struct {
+    bool (*push)(void *queue, const htu21d_record_t *record);
+    bool (*pop)(void *queue, htu21d_record_t *record);
+    const char *name;
+} queue_ops_t;
+
+typedef struct {
+    const queue_ops_t *ops;
+    void *queue;
+    uint16_t source;
+    uint64_t records;
+} producer_t;
+
+static int _producers_running;
+static uint64_t _received;
+static unsigned _errors;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static bool lock_free_push(void *queue, const htu21d_record_t *record)
+{
+    return htu21d_queue_push(queue, record);
+}
+
+static bool lock_free_pop(void *queue, htu21d_record_t *record)
+{
+    return htu21d_queue_pop(queue, record);
+}
+
+static bool mutex_push(void *queue, const htu21d_record_t *record)
+{
+    mutex_queue_t *q = queue;
+    bool pushed = false;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->head - q->tail < q->capacity) {
+        q->records[q->head++ % q->capacity] = *record;
+        pushed = true;
+    } else {
+        q->overflows++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pushed;
+}
+
+static bool mutex_pop(void *queue, htu21d_record_t *record)
+{
+    mutex_queue_t *q = queue;
+    bool popped = false;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->tail != q->head) {
+        *record = q->records[q->tail++ % q->capacity];
+        popped = true;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return popped;
+}
+
+static const queue_ops_t _lock_free_ops = {lock_free_push, lock_free_pop, "lock-free"};
+static const queue_ops_t _mutex_ops = {mutex_push, mutex_pop, "mutex"};
+
+static void *producer(void *arg)
+{
+    producer_t *p = arg;
+    htu21d_record_t record = {.source = p->source};
+
+    for (uint64_t i = 0; i < p->records; i++) {
+        // timestamp_us doubles as the sequence number
+        record.sample.timestamp_us = i;
+        while (!p->ops->push(p->queue, &record)) {
+            sched_yield();
+        }
+    }
+    __atomic_fetch_sub(&_producers_running, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void consume(const queue_ops_t *ops, void *queue, uint64_t next[MAX_PRODUCERS])
+{
+    htu21d_record_t record;
+
+    for (;;) {
+        bool done = __atomic_load_n(&_producers_running, __ATOMIC_ACQUIRE) == 0;
+        while (ops->pop(queue, &record)) {
+            if (record.source >= MAX_PRODUCERS || record.sample.timestamp_us != next[record.source]) {
+                _errors++;
+            } else {
+                next[record.source]++;
+            }
+            _received++;
+        }
+        if (done) {
+            return;
+        }
+        sched_yield();
+    }
+}
+
+static int run(const queue_ops_t *ops, void *queue, int producers, uint64_t records,
+               uint32_t (*overflows)(void *queue))
+{
+    pthread_t threads[MAX_PRODUCERS];
+    producer_t state[MAX_PRODUCERS];
+    uint64_t next[MAX_PRODUCERS] = {0};
+
+    _producers_running = producers;
+    _received = 0;
+    _errors = 0;
+
+    uint64_t start_ns = now_ns();
+    for (int i = 0; i < producers; i++) {
+        state[i] = (producer_t) {
+            .ops = ops, .queue = queue, .source = (uint16_t) i, .records = records / producers,
+        };
+        pthread_create(&threads[i], NULL, producer, &state[i]);
+    }
+    consume(ops, queue, next);
+    for (int i = 0; i < producers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    uint64_t sent = 0;
+    for (int i = 0; i < producers; i++) {
+        sent += state[i].records;
+        if (next[i] != state[i].records) {
+            _errors++;
+        }
+    }
+    if (_received != sent) {
+        _errors++;
+    }
+
+    printf("%-10d %-10s %12.2f %10.1f %10.3f\n", producers, ops->name, _received * 1e3 / elapsed_ns,
+           (double) elapsed_ns / sent, (double) overflows(queue) / sent);
+    if (_errors) {
+        fprintf(stderr, "%s, %d producers: %u records lost, duplicated or out of order\n", ops->name,
+                producers, _errors);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t lock_free_overflows(void *queue)
+{
+    return htu21d_queue_overflows(queue);
+}
+
+static uint32_t mutex_overflows(void *queue)
+{
+    return ((mutex_queue_t *) queue)->overflows;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t records = 2000000;
+    uint32_t capacity = 256;
+    int failed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--records") == 0 && i + 1 < argc) {
+            records = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            capacity = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--records N] [--capacity N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    htu21d_queue_slot_t *slots = calloc(capacity, sizeof(htu21d_queue_slot_t));
+    htu21d_record_t *ring = calloc(capacity, sizeof(htu21d_record_t));
+    if (slots == NULL || ring == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    printf("HTU21D sample queue, %llu records of %zu bytes, capacity %u\n\n",
+           (unsigned long long) records, sizeof(htu21d_record_t), capacity);
+    printf("%-10s %-10s %12s %10s %10s\n", "Producers", "Queue", "Mrecords/s", "ns/record", "Full/rec");
+
+    for (int producers = 1; producers <= MAX_PRODUCERS; producers *= 2) {
+        htu21d_queue_t queue;
+        if (htu21d_queue_init(&queue, slots, capacity) != HTU21D_ERR_OK) {
+            fprintf(stderr, "Capacity must be a power of two\n");
+            return EXIT_FAILURE;
+        }
+        if (run(&_lock_free_ops, &queue, producers, records, lock_free_overflows) != 0) {
+            failed = 1;
+        }
+
+        mutex_queue_t baseline = {.records = ring, .capacity = capacity};
+        pthread_mutex_init(&baseline.lock, NULL);
+        if (run(&_mutex_ops, &baseline, producers, records, mutex_overflows) != 0) {
+            failed = 1;
+        }
+        pthread_mutex_destroy(&baseline.lock);
+    }
+
+    free(slots);
+    free(ring);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file bench_read_modes.c
+ * @brief Read mode comparison benchmark, per transport, against the simulated
+ * sensor.
+ *
+ * Takes the same series of measurements (read_value(), alternating
+ * temperature and humidity) in every read mode:
+ *
+ * - fixed wait: #HTU21D_READ_MODE_FIXED_WAIT
+ * - polling:    #HTU21D_READ_MODE_POLLING
+ * - hold:       #HTU21D_READ_MODE_HOLD
+ *
+ * and reports mean, p99 and max latency per sample, host CPU time per sample,
+ * bus time and occupancy, transactions and task wakeups (delays) per sample.
+ * Conversion times vary between the datasheet's typical and maximum like on
+ * real parts (sim_set_jitter()).
+ *
+ * The transport is chosen at link time, so this file is built twice:
+ *
+ * - bench_read_modes:     every port call is one bus transaction, like the
+ *                         Linux i2c-dev port (sim_port.c)
+ * - bench_read_modes_idf: the real ESP-IDF legacy I2C port, building command
+ *                         links, on host stand-ins of the IDF I2C driver and a
+ *                         100 Hz FreeRTOS tick (idf_shim/)
+ *
+ * `cmake --build build --target read_modes_report` runs both.
+ *
+ * Usage: bench_read_modes [--samples N] [--resolution 0xNN]
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d.h"
+#include "sim_bus.h"
+
+#ifdef ESP_PLATFORM
+#define TRANSPORT_NAME "ESP-IDF legacy I2C driver, command links, 100 Hz tick"
+#else
+#define TRANSPORT_NAME "direct, one transaction per port call (i2c-dev like)"
+#endif
+
+static const struct {
+    const char *name;
+    htu21d_read_mode_t mode;
+} _modes[] = {
+    {"fixed wait", HTU21D_READ_MODE_FIXED_WAIT},
+    {"polling", HTU21D_READ_MODE_POLLING},
+    {"hold", HTU21D_READ_MODE_HOLD},
+};
+
+static unsigned _wakeups;
+
+static uint64_t cpu_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void on_bus_op(sim_op_t op)
+{
+    if (op == SIM_OP_DELAY) {
+        _wakeups++;
+    }
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    int samples = 10000;
+    uint8_t resolution = 0x00;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            resolution = (uint8_t) strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--samples N] [--resolution 0xNN]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (samples < 1) {
+        samples = 1;
+    }
+
+    uint32_t *latency_us = malloc(samples * sizeof(uint32_t));
+    if (latency_us == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    printf("HTU21D read modes, %s\n(resolution 0x%02X, simulated 100 kHz bus, conversion jitter, %d samples)\n\n",
+           TRANSPORT_NAME, resolution, samples);
+    printf("%-11s %9s %9s %9s %11s %11s %9s %8s %9s\n", "Mode", "Mean ms", "p99 ms", "Max ms",
+           "CPU us/smp", "Bus us/smp", "Bus use", "Xfers", "Wakeups");
+
+    for (size_t m = 0; m < sizeof(_modes) / sizeof(_modes[0]); m++) {
+        sim_reset();
+        sim_add_sensor(0, HTU21D_NO_MUX, 0);
+        if (htu21d_init(0, 1, 2, GPIO_PULLUP_ENABLE, GPIO_PULLUP_ENABLE) != HTU21D_ERR_OK ||
+                htu21d_set_resolution(resolution) != HTU21D_ERR_OK) {
+            fprintf(stderr, "Setup failed\n");
+            return EXIT_FAILURE;
+        }
+        htu21d_get_default_dev()->read_mode = _modes[m].mode;
+        sim_set_jitter(true);
+        sim_set_observer(on_bus_op);
+        _wakeups = 0;
+
+        sim_stats_t before = sim_stats();
+        uint64_t start_us = sim_now_us();
+        uint64_t start_cpu_ns = cpu_now_ns();
+        for (int s = 0; s < samples; s++) {
+            uint64_t sample_start_us = sim_now_us();
+            uint8_t command = s % 2 ? TRIGGER_HUMD_MEASURE_NOHOLD : TRIGGER_TEMP_MEASURE_NOHOLD;
+            if (read_value(command) == 0) {
+                fprintf(stderr, "%s: sample %d failed\n", _modes[m].name, s);
+                return EXIT_FAILURE;
+            }
+            latency_us[s] = (uint32_t)(sim_now_us() - sample_start_us);
+        }
+        uint64_t cpu_ns = cpu_now_ns() - start_cpu_ns;
+        uint64_t total_us = sim_now_us() - start_us;
+        sim_stats_t after = sim_stats();
+        sim_set_observer(NULL);
+
+        qsort(latency_us, samples, sizeof(uint32_t), compare_u32);
+        double bus_us = (double)(after.bus_us - before.bus_us);
+        printf("%-11s %9.2f %9.2f %9.2f %11.2f %11.1f %8.1f%% %8.2f %9.2f\n", _modes[m].name,
+               total_us / 1000.0 / samples, latency_us[(samples * 99 + 99) / 100 - 1] / 1000.0,
+               latency_us[samples - 1] / 1000.0, cpu_ns / 1000.0 / samples, bus_us / samples,
+               100.0 * bus_us / total_us, (double)(after.transactions - before.transactions) / samples,
+               (double) _wakeups / samples);
+    }
+
+    free(latency_us);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file bench_scaling.c
+ * @brief Multi-sensor scalability benchmark against the simulated bus.
+ *
+ * Puts 1..64 simulated HTU21D sensors on two buses behind TCA9548A muxes
+ * (sensor `i` goes on bus `i % 2`, then fills mux 0x70 channels 0-7, mux 0x71,
+ * ...) and runs full sweeps, one temperature + humidity pair per sensor, in
+ * each read mode:
+ *
+ * - fixed wait: htu21d_dev_read_*() with #HTU21D_READ_MODE_FIXED_WAIT
+ * - polling:    htu21d_dev_read_*() with #HTU21D_READ_MODE_POLLING
+ * - hold:       htu21d_dev_read_*() with #HTU21D_READ_MODE_HOLD
+ * - pipelined:  start the conversion on every sensor, wait once, fetch all
+ *
+ * For every sensor count and mode it reports the sweep latency, T+RH samples
+ * per second, bus utilization, host CPU time per sweep and the number of
+ * transactions, plus the driver's memory cost per sensor.
+ *
+ * Usage: bench_scaling [--sweeps N] [--resolution 0xNN]
+ *
+ * Exits non-zero if any read fails or two sensors ever answer at once.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d.h"
+#include "sim_bus.h"
+
+#define MAX_SENSORS 64
+#define BUS_COUNT   2
+
+typedef enum {
+    MODE_FIXED_WAIT,
+    MODE_POLLING,
+    MODE_HOLD,
+    MODE_PIPELINED,
+    MODE_COUNT,
+} bench_mode_t;
+
+static const char *_mode_names[MODE_COUNT] = {"fixed wait", "polling", "hold", "pipelined"};
+
+static htu21d_dev_t _devs[MAX_SENSORS];
+
+static uint64_t cpu_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static uint8_t mux_address(int sensor)
+{
+    return 0x70 + (sensor / BUS_COUNT) / 8;
+}
+
+static uint8_t mux_channel(int sensor)
+{
+    return (sensor / BUS_COUNT) % 8;
+}
+
+static int setup(int count, uint8_t resolution, bench_mode_t mode)
+{
+    sim_reset();
+    for (int bus = 0; bus < BUS_COUNT; bus++) {
+        if (htu21d_bus_init(bus, -1, -1, GPIO_PULLUP_DISABLE, GPIO_PULLUP_DISABLE) != HTU21D_ERR_OK) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        sim_add_sensor(i % BUS_COUNT, mux_address(i), mux_channel(i));
+    }
+    for (int i = 0; i < count; i++) {
+        htu21d_dev_t *dev = &_devs[i];
+        if (htu21d_dev_init(dev, i % BUS_COUNT, mux_address(i), mux_channel(i)) != HTU21D_ERR_OK ||
+                htu21d_dev_set_resolution(dev, resolution) != HTU21D_ERR_OK) {
+            return -1;
+        }
+        dev->read_mode = mode == MODE_POLLING ? HTU21D_READ_MODE_POLLING
+                         : mode == MODE_HOLD ? HTU21D_READ_MODE_HOLD : HTU21D_READ_MODE_FIXED_WAIT;
+    }
+    return 0;
+}
+
+static int sweep_sequential(int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (htu21d_dev_read_temperature(&_devs[i]) == -999 ||
+                htu21d_dev_read_humidity(&_devs[i]) == -999) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int sweep_pipelined(int count, uint8_t resolution)
+{
+    static const uint8_t commands[2] = {TRIGGER_TEMP_MEASURE_NOHOLD, TRIGGER_HUMD_MEASURE_NOHOLD};
+    uint16_t raw;
+
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < count; i++) {
+            if (htu21d_dev_start_measurement(&_devs[i], commands[c]) != HTU21D_ERR_OK) {
+                return -1;
+            }
+        }
+        sim_advance_ms(htu21d_conversion_time_ms(resolution, commands[c]));
+        for (int i = 0; i < count; i++) {
+            if (htu21d_dev_fetch_measurement(&_devs[i], &raw) != HTU21D_ERR_OK) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int sweeps = 10;
+    uint8_t resolution = 0x00;
+    int failed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sweeps") == 0 && i + 1 < argc) {
+            sweeps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            resolution = (uint8_t) strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--sweeps N] [--resolution 0xNN]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (sweeps < 1) {
+        sweeps = 1;
+    }
+
+    printf("HTU21D multi-sensor scaling (resolution 0x%02X, %d buses, simulated 100 kHz, %d sweeps)\n\n",
+           resolution, BUS_COUNT, sweeps);
+    printf("Driver memory: %zu bytes per sensor (htu21d_dev_t), no heap, plus a fixed table for %d buses\n\n",
+           sizeof(htu21d_dev_t), HTU21D_MAX_BUSES);
+    printf("%-8s %-11s %12s %12s %9s %14s %10s\n", "Sensors", "Mode", "Sweep ms", "Samples/s",
+           "Bus use", "CPU us/sweep", "Xfers");
+
+    for (int count = 1; count <= MAX_SENSORS; count *= 2) {
+        for (bench_mode_t mode = 0; mode < MODE_COUNT; mode++) {
+            if (setup(count, resolution, mode) != 0) {
+                fprintf(stderr, "Setup of %d sensors failed\n", count);
+                return EXIT_FAILURE;
+            }
+
+            sim_stats_t before = sim_stats();
+            uint64_t start_us = sim_now_us();
+            uint64_t start_cpu_ns = cpu_now_ns();
+            for (int s = 0; s < sweeps; s++) {
+                int ret = mode == MODE_PIPELINED ? sweep_pipelined(count, resolution) : sweep_sequential(count);
+                if (ret != 0) {
+                    fprintf(stderr, "%d sensors, %s: sweep failed\n", count, _mode_names[mode]);
+                    failed = 1;
+                    break;
+                }
+            }
+            uint64_t cpu_ns = cpu_now_ns() - start_cpu_ns;
+            sim_stats_t after = sim_stats();
+            double sweep_us = (double)(sim_now_us() - start_us) / sweeps;
+            double bus_us = (double)(after.bus_us - before.bus_us) / sweeps;
+
+            printf("%-8d %-11s %12.2f %12.1f %8.1f%% %14.2f %10.1f\n", count, _mode_names[mode],
+                   sweep_us / 1000.0, count * 1e6 / sweep_us, 100.0 * bus_us / sweep_us,
+                   cpu_ns / 1000.0 / sweeps, (double)(after.transactions - before.transactions) / sweeps);
+
+            if (after.conflicts != 0) {
+                fprintf(stderr, "%d sensors, %s: %u bus conflicts\n", count, _mode_names[mode], after.conflicts);
+                failed = 1;
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file bench_spectrum.c
+ * @brief Per-sample cost of the staged cycle analysis.
+ *
+ * Feeds 10 s samples with a 6 minute temperature cycle (a
+ * short-cycling compressor) and a 20 minute humidity cycle through
+ * htu21d_spectrum_add() and reports, per window size, the worst single call
+ * next to the time of all the steps of a window run back to back. The worst
+ * call is what the sampling task stalls for; doing the window in one go would
+ * stall it for the whole total. The first window only warms up the caches and
+ * is not timed.
+ *
+ * Usage: bench_spectrum [--size N] [--windows N]
+ *
+ * Exits non-zero if the reported strongest cycles are off by more than 5 %.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d_spectrum.h"
+
+#define INTERVAL_S      10.0F
+#define PERIOD_T_S      360.0F
+#define PERIOD_RH_S     1200.0F
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static int run(uint16_t size, int windows)
+{
+    float *buffer = malloc(2 * size * sizeof(float));
+    htu21d_spectrum_t spectrum;
+
+    if (buffer == NULL || htu21d_spectrum_init(&spectrum, buffer, size, INTERVAL_S) != HTU21D_ERR_OK) {
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t worst_add_ns = 0, worst_step_ns = 0, analysis_ns = 0;
+    for (uint32_t i = 0; spectrum.result.windows < (uint32_t) windows; i++) {
+        htu21d_sample_t sample;
+        float t = i * INTERVAL_S;
+        uint16_t code_t = (uint16_t)(0x6000 + 400.0F * sinf(6.2831853F * t / PERIOD_T_S)) & 0xFFFC;
+        uint16_t code_rh = (uint16_t)(0x7000 + 2000.0F * sinf(6.2831853F * t / PERIOD_RH_S)) & 0xFFFC;
+        htu21d_sample_from_raw(&sample, code_t, code_rh, 0x00, HTU21D_SAMPLE_CRC_OK, i * 10000000ULL);
+
+        bool warm = spectrum.result.windows > 0;
+        bool collecting = spectrum.filled < spectrum.size;
+        uint64_t start = now_ns();
+        htu21d_spectrum_add(&spectrum, &sample);
+        uint64_t elapsed = now_ns() - start;
+        if (!warm) {
+            continue;
+        }
+        if (collecting) {
+            worst_add_ns = elapsed > worst_add_ns ? elapsed : worst_add_ns;
+        } else {
+            worst_step_ns = elapsed > worst_step_ns ? elapsed : worst_step_ns;
+            analysis_ns += elapsed;
+        }
+    }
+
+    const htu21d_spectrum_result_t *result = htu21d_spectrum_result(&spectrum);
+    printf("%-6u %12.2f %14.2f %16.2f %9.1f s %9.1f s\n", size, worst_add_ns / 1e3, worst_step_ns / 1e3,
+           analysis_ns / 1e3 / (windows - 1), result->temperature[0].period_s, result->humidity[0].period_s);
+    free(buffer);
+
+    if (fabsf(result->temperature[0].period_s - PERIOD_T_S) > 0.05F * PERIOD_T_S ||
+            fabsf(result->humidity[0].period_s - PERIOD_RH_S) > 0.05F * PERIOD_RH_S) {
+        fprintf(stderr, "%u samples: wrong dominant cycles\n", size);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t size = 0;
+    int windows = 20;
+    static const uint16_t sizes[] = {256, 1024, 4096};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = (uint16_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            windows = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--size N] [--windows N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (windows < 2) {
+        return EXIT_FAILURE;
+    }
+
+    printf("HTU21D cycle analysis, %.0f s samples, %d windows per size\n\n", INTERVAL_S, windows);
+    printf("%-6s %12s %14s %16s %11s %11s\n", "Size", "Add us (max)", "Step us (max)", "Window us (sum)",
+           "T cycle", "RH cycle");
+
+    int failed = 0;
+    if (size != 0) {
+        failed = run(size, windows);
+    } else {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            failed |= run(sizes[s], windows);
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file bench_startup.c
+ * @brief Boot-to-first-sample startup benchmark against the simulated sensor.
+ *
+ * Runs the startup sequence of a duty-cycled node and reports each phase:
+ *
+ * 1. I2C config      - htu21d_init() up to the driver install
+ * 2. Driver install  - htu21d_init() up to the probe
+ * 3. Probe           - rest of htu21d_init()
+ * 4. Resolution      - htu21d_set_resolution(), restoring the node's setting
+ * 5. First sample    - htu21d_read_temperature() + htu21d_read_humidity()
+ *
+ * "Bus/sensor" time is the simulated wire, conversion and wait time, which is
+ * what dominates on hardware. "Host CPU" is the real CPU time spent in the
+ * driver and port on this machine.
+ *
+ * Usage: bench_startup [--resolution 0xNN] [--budget-us N]
+ *
+ * With `--budget-us` the benchmark exits non-zero when the simulated
+ * boot-to-first-sample time exceeds the budget, which ctest uses to guard
+ * startup time against regressions.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "htu21d.h"
+#include "sim_bus.h"
+
+/**
+ * @brief Startup phases, in the order they happen.
+ */
+typedef enum {
+    PHASE_CONFIG,
+    PHASE_INSTALL,
+    PHASE_PROBE,
+    PHASE_RESOLUTION,
+    PHASE_FIRST_SAMPLE,
+    PHASE_COUNT,
+} phase_t;
+
+static const char *_phase_names[PHASE_COUNT] = {
+    "I2C config",
+    "Driver install",
+    "Probe",
+    "Resolution restore",
+    "First sample (T+RH)",
+};
+
+static uint64_t _start_sim_us[PHASE_COUNT + 1];
+static uint64_t _start_cpu_ns[PHASE_COUNT + 1];
+static phase_t _phase;
+
+static uint64_t cpu_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void enter_phase(phase_t phase)
+{
+    _phase = phase;
+    _start_sim_us[phase] = sim_now_us();
+    _start_cpu_ns[phase] = cpu_now_ns();
+}
+
+// splits htu21d_init() at the port calls it makes
+static void on_port_op(sim_op_t op)
+{
+    if (op == SIM_OP_BUS_INSTALL && _phase == PHASE_CONFIG) {
+        enter_phase(PHASE_INSTALL);
+    } else if (op == SIM_OP_PROBE && _phase == PHASE_INSTALL) {
+        enter_phase(PHASE_PROBE);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t resolution = 0x00;
+    long budget_us = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            resolution = (uint8_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc) {
+            budget_us = strtol(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--resolution 0xNN] [--budget-us N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    sim_reset();
+    sim_add_sensor(0, HTU21D_NO_MUX, 0);
+    sim_set_observer(on_port_op);
+
+    enter_phase(PHASE_CONFIG);
+    int ret = htu21d_init(0, 1, 2, GPIO_PULLUP_ENABLE, GPIO_PULLUP_ENABLE);
+    if (ret != HTU21D_ERR_OK) {
+        fprintf(stderr, "htu21d_init() failed: %d\n", ret);
+        return EXIT_FAILURE;
+    }
+
+    enter_phase(PHASE_RESOLUTION);
+    ret = htu21d_set_resolution(resolution);
+    if (ret != HTU21D_ERR_OK) {
+        fprintf(stderr, "htu21d_set_resolution() failed: %d\n", ret);
+        return EXIT_FAILURE;
+    }
+
+    enter_phase(PHASE_FIRST_SAMPLE);
+    float temperature = htu21d_read_temperature();
+    float humidity = htu21d_read_humidity();
+    if (temperature == -999 || humidity == -999) {
+        fprintf(stderr, "First sample failed\n");
+        return EXIT_FAILURE;
+    }
+
+    enter_phase(PHASE_COUNT);
+    sim_set_observer(NULL);
+
+    sim_stats_t stats = sim_stats();
+    uint64_t total_us = _start_sim_us[PHASE_COUNT];
+
+    printf("HTU21D boot-to-first-sample (resolution 0x%02X, simulated 100 kHz bus)\n\n", resolution);
+    printf("%-22s %14s %12s\n", "Phase", "Bus/sensor us", "Host CPU ns");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        printf("%-22s %14llu %12llu\n", _phase_names[phase],
+               (unsigned long long)(_start_sim_us[phase + 1] - _start_sim_us[phase]),
+               (unsigned long long)(_start_cpu_ns[phase + 1] - _start_cpu_ns[phase]));
+    }
+    printf("%-22s %14llu %12llu\n\n", "Total", (unsigned long long) total_us,
+           (unsigned long long)(_start_cpu_ns[PHASE_COUNT] - _start_cpu_ns[0]));
+    printf("Transactions: %u (NACKed: %u), bus busy: %llu us, waiting: %llu us\n",
+           stats.transactions, stats.nacks, (unsigned long long) stats.bus_us,
+           (unsigned long long) stats.delay_us);
+    printf("First sample: %.2f degC, %.2f %%RH\n", temperature, humidity);
+
+    if (budget_us >= 0 && total_us > (uint64_t) budget_us) {
+        fprintf(stderr, "Startup took %llu us, over the %ld us budget\n",
+                (unsigned long long) total_us, budget_us);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file bench_sweep.c
+ * @brief Trigger skew of a synchronized sweep vs. sequential reads.
+ *
+ * Puts 1..N simulated HTU21D sensors on two buses behind TCA9548A muxes (the
+ * layout of bench_scaling.c) and measures temperature on all of them:
+ *
+ * - sequential: htu21d_dev_read_value() per sensor, the conversion of each
+ *               starting when the previous one has been read
+ * - sweep:      htu21d_sweep(), every conversion triggered in one burst
+ *
+ * and reports the largest and the mean skew between the sensors' conversion
+ * starts, and the time a full pass takes.
+ *
+ * Usage: bench_sweep [--sensors N] [--max-skew-us US]
+ *
+ * Exits non-zero if a read fails or, with --max-skew-us, if the sweep's skew
+ * across all N sensors exceeds US.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "htu21d.h"
+#include "htu21d_sweep.h"
+#include "sim_bus.h"
+
+#define BUS_COUNT   2
+
+static htu21d_dev_t _devs[HTU21D_SWEEP_MAX_SENSORS];
+static htu21d_sweep_result_t _results[HTU21D_SWEEP_MAX_SENSORS];
+
+static uint8_t mux_address(int sensor)
+{
+    return 0x70 + (sensor / BUS_COUNT) / 8;
+}
+
+static uint8_t mux_channel(int sensor)
+{
+    return (sensor / BUS_COUNT) % 8;
+}
+
+static int setup(int count)
+{
+    sim_reset();
+    for (int bus = 0; bus < BUS_COUNT; bus++) {
+        if (htu21d_bus_init(bus, -1, -1, GPIO_PULLUP_DISABLE, GPIO_PULLUP_DISABLE) != HTU21D_ERR_OK) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        sim_add_sensor(i % BUS_COUNT, mux_address(i), mux_channel(i));
+    }
+    for (int i = 0; i < count; i++) {
+        if (htu21d_dev_init(&_devs[i], i % BUS_COUNT, mux_address(i), mux_channel(i)) != HTU21D_ERR_OK) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads every sensor in turn, noting when each read started (its
+ * conversion starts a channel select and a trigger later).
+ */
+static int sequential(int count, uint64_t *skew_max_us, uint64_t *skew_sum_us)
+{
+    uint64_t first_us = sim_now_us();
+
+    *skew_max_us = 0;
+    *skew_sum_us = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t skew_us = sim_now_us() - first_us;
+        if (htu21d_dev_read_value(&_devs[i], TRIGGER_TEMP_MEASURE_NOHOLD) == 0) {
+            return -1;
+        }
+        *skew_max_us = skew_us > *skew_max_us ? skew_us : *skew_max_us;
+        *skew_sum_us += skew_us;
+    }
+    return 0;
+}
+
+static int sweep(int count, uint64_t *skew_max_us, uint64_t *skew_sum_us)
+{
+    if (htu21d_sweep(_devs, count, TRIGGER_TEMP_MEASURE_NOHOLD, _results) != HTU21D_ERR_OK) {
+        return -1;
+    }
+    *skew_max_us = 0;
+    *skew_sum_us = 0;
+    for (int i = 0; i < count; i++) {
+        *skew_max_us = _results[i].skew_us > *skew_max_us ? _results[i].skew_us : *skew_max_us;
+        *skew_sum_us += _results[i].skew_us;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int sensors = 64;
+    long max_skew_us = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc) {
+            sensors = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-skew-us") == 0 && i + 1 < argc) {
+            max_skew_us = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--sensors N] [--max-skew-us US]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (sensors < 1 || sensors > HTU21D_SWEEP_MAX_SENSORS) {
+        fprintf(stderr, "--sensors must be 1-%d\n", HTU21D_SWEEP_MAX_SENSORS);
+        return EXIT_FAILURE;
+    }
+
+    printf("Temperature trigger skew, %d buses, simulated 100 kHz\n\n", BUS_COUNT);
+    printf("%-8s %-11s %14s %14s %10s\n", "Sensors", "Mode", "Max skew us", "Mean skew us", "Pass ms");
+
+    uint64_t sweep_max_us = 0;
+    for (int count = 1; ; count = count * 2 < sensors ? count * 2 : sensors) {
+        for (int mode = 0; mode < 2; mode++) {
+            uint64_t skew_max_us, skew_sum_us;
+            if (setup(count) != 0) {
+                fprintf(stderr, "Setup of %d sensors failed\n", count);
+                return EXIT_FAILURE;
+            }
+            uint64_t start_us = sim_now_us();
+            int ret = mode == 0 ? sequential(count, &skew_max_us, &skew_sum_us)
+                      : sweep(count, &skew_max_us, &skew_sum_us);
+            if (ret != 0) {
+                fprintf(stderr, "%d sensors: %s failed\n", count, mode == 0 ? "sequential" : "sweep");
+                return EXIT_FAILURE;
+            }
+            printf("%-8d %-11s %14llu %14.1f %10.2f\n", count, mode == 0 ? "sequential" : "sweep",
+                   (unsigned long long) skew_max_us, (double) skew_sum_us / count,
+                   (sim_now_us() - start_us) / 1000.0);
+            if (mode == 1) {
+                sweep_max_us = skew_max_us;
+            }
+        }
+        if (count == sensors) {
+            break;
+        }
+    }
+
+    if (max_skew_us >= 0 && sweep_max_us > (uint64_t) max_skew_us) {
+        fprintf(stderr, "Sweep skew %llu us over the %ld us budget\n", (unsigned long long) sweep_max_us,
+                max_skew_us);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,14 @@
+/**
+ * @file esp_log.h
+ * @brief Host stand-in for ESP-IDF logging.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fprintf(stdout, "I %s: " format "\n", tag, ##__VA_ARGS__)
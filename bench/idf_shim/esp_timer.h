@@ -0,0 +1,16 @@
+/**
+ * @file esp_timer.h
+ * @brief Host stand-in for the ESP-IDF high resolution timer, on the
+ * simulated clock.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds of simulated time since sim_reset().
+ */
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,16 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS tick definitions.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+
+#define portTICK_PERIOD_MS  (1000 / CONFIG_FREERTOS_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * CONFIG_FREERTOS_HZ) / 1000))
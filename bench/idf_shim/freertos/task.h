@@ -0,0 +1,15 @@
+/**
+ * @file task.h
+ * @brief Host stand-in for the FreeRTOS task functions used by the port layer.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Advances the simulated clock by whole ticks.
+ */
+void vTaskDelay(TickType_t ticks);
@@ -0,0 +1,364 @@
+/**
+ * @file idf_shim.c
+ * @brief Host stand-in for the ESP-IDF legacy I2C master driver and FreeRTOS
+ * delays, running on the simulated bus.
+ *
+ * Lets the real ESP-IDF port (port/htu21d_port_esp.c) run in host benchmarks.
+ * i2c_master_cmd_begin() turns a queued command link back into one
+ * `sim_i2c_*` transaction.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2c.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "htu21d.h"
+#include "idf_shim.h"
+#include "sim_bus.h"
+
+#define SHIM_MAX_TRANSFER   16  /**< Payload bytes per direction in one command link. */
+#define SHIM_MAX_READS      4   /**< Read commands in one command link. */
+
+typedef enum {
+    CMD_START,
+    CMD_WRITE,
+    CMD_READ,
+    CMD_STOP,
+} cmd_op_t;
+
+/**
+ * @brief One queued command, like ESP-IDF's `i2c_cmd_link_t`.
+ */
+typedef struct cmd_node {
+    struct cmd_node *next;
+    cmd_op_t op;
+    uint8_t byte;               /**< Storage for i2c_master_write_byte(). */
+    const uint8_t *write_data;
+    uint8_t *read_data;
+    size_t len;
+} cmd_node_t;
+
+/**
+ * @brief Command link handle, like ESP-IDF's `i2c_cmd_desc_t`.
+ */
+typedef struct {
+    cmd_node_t *head;
+    cmd_node_t *tail;
+    uint8_t *free;              /**< Next free byte of a static link's buffer, `NULL` if on the heap. */
+    uint8_t *end;
+} cmd_desc_t;
+
+_Static_assert(sizeof(cmd_node_t) <= I2C_INTERNAL_STRUCT_SIZE, "I2C_INTERNAL_STRUCT_SIZE too small");
+_Static_assert(sizeof(cmd_desc_t) <= I2C_INTERNAL_STRUCT_SIZE, "I2C_INTERNAL_STRUCT_SIZE too small");
+
+static idf_shim_blocked_hook_t _blocked_hook;
+
+static void run_blocked_hook(void)
+{
+    if (_blocked_hook != NULL) {
+        _blocked_hook();
+    }
+}
+
+static esp_err_t to_esp_err(int ret)
+{
+    switch (ret) {
+
+    case HTU21D_ERR_OK:
+        return ESP_OK;
+
+    case HTU21D_ERR_INVALID_ARG:
+        return ESP_ERR_INVALID_ARG;
+
+    case HTU21D_ERR_TIMEOUT:
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_FAIL;
+}
+
+void idf_shim_set_blocked_hook(idf_shim_blocked_hook_t hook)
+{
+    _blocked_hook = hook;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+
+    case ESP_OK:
+        return "ESP_OK";
+
+    case ESP_FAIL:
+        return "ESP_FAIL";
+
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    }
+    return "UNKNOWN ERROR";
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    run_blocked_hook();
+    sim_delay_ms(ticks * portTICK_PERIOD_MS);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t) sim_now_us();
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || i2c_conf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return to_esp_err(sim_i2c_bus_config(i2c_num));
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len,
+                             size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    (void) slv_rx_buf_len;
+    (void) slv_tx_buf_len;
+    (void) intr_alloc_flags;
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return to_esp_err(sim_i2c_bus_install(i2c_num));
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(cmd_desc_t));
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    if (buffer == NULL || size < I2C_INTERNAL_STRUCT_SIZE || (uintptr_t) buffer % sizeof(void *) != 0) {
+        return NULL;
+    }
+    memset(buffer, 0, size);
+    cmd_desc_t *desc = (cmd_desc_t *) buffer;
+    desc->free = buffer + I2C_INTERNAL_STRUCT_SIZE;
+    desc->end = buffer + size;
+    return desc;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    cmd_desc_t *desc = cmd_handle;
+    if (desc == NULL || desc->free != NULL) {
+        return;
+    }
+    cmd_node_t *node = desc->head;
+    while (node != NULL) {
+        cmd_node_t *next = node->next;
+        free(node);
+        node = next;
+    }
+    free(desc);
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle)
+{
+    // lives in the caller's buffer
+    (void) cmd_handle;
+}
+
+/**
+ * @brief Appends a command, from the static buffer or the heap.
+ */
+static cmd_node_t *cmd_append(i2c_cmd_handle_t cmd_handle, cmd_op_t op)
+{
+    cmd_desc_t *desc = cmd_handle;
+    cmd_node_t *node;
+
+    if (desc == NULL) {
+        return NULL;
+    }
+    if (desc->free != NULL) {
+        if (desc->end - desc->free < I2C_INTERNAL_STRUCT_SIZE) {
+            return NULL;
+        }
+        node = (cmd_node_t *) desc->free;
+        desc->free += I2C_INTERNAL_STRUCT_SIZE;
+    } else {
+        node = calloc(1, sizeof(cmd_node_t));
+        if (node == NULL) {
+            return NULL;
+        }
+    }
+    node->op = op;
+    if (desc->tail != NULL) {
+        desc->tail->next = node;
+    } else {
+        desc->head = node;
+    }
+    desc->tail = node;
+    return node;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return cmd_append(cmd_handle, CMD_START) != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    (void) ack_en;
+    cmd_node_t *node = cmd_append(cmd_handle, CMD_WRITE);
+    if (node == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    node->byte = data;
+    node->write_data = &node->byte;
+    node->len = 1;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    (void) ack_en;
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cmd_node_t *node = cmd_append(cmd_handle, CMD_WRITE);
+    if (node == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    node->write_data = data;
+    node->len = data_len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    return i2c_master_read(cmd_handle, data, 1, ack);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    (void) ack;
+    if (data == NULL || data_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cmd_node_t *node = cmd_append(cmd_handle, CMD_READ);
+    if (node == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    node->read_data = data;
+    node->len = data_len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return cmd_append(cmd_handle, CMD_STOP) != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Runs a command link as the single simulated transaction it
+ * describes: a probe, a write, a read or a write + repeated START + read.
+ */
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    cmd_desc_t *desc = cmd_handle;
+    uint8_t addresses[2];
+    int starts = 0;
+    bool expect_address = false;
+    uint8_t write_data[SHIM_MAX_TRANSFER];
+    size_t write_len = 0;
+    uint8_t read_data[SHIM_MAX_TRANSFER];
+    size_t read_len = 0;
+    cmd_node_t *reads[SHIM_MAX_READS];
+    int read_count = 0;
+
+    if (desc == NULL || i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // the calling task blocks until the transaction is done
+    run_blocked_hook();
+
+    for (cmd_node_t *node = desc->head; node != NULL; node = node->next) {
+        switch (node->op) {
+
+        case CMD_START:
+            if (starts == 2) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            expect_address = true;
+            break;
+
+        case CMD_WRITE:
+            if (expect_address) {
+                addresses[starts++] = node->write_data[0];
+                expect_address = false;
+                if (node->len == 1) {
+                    break;
+                }
+                // the rest of the buffer is payload
+                if (write_len + node->len - 1 > sizeof(write_data)) {
+                    return ESP_ERR_INVALID_SIZE;
+                }
+                memcpy(write_data + write_len, node->write_data + 1, node->len - 1);
+                write_len += node->len - 1;
+                break;
+            }
+            if (starts == 0 || (addresses[starts - 1] & 1) || write_len + node->len > sizeof(write_data)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            memcpy(write_data + write_len, node->write_data, node->len);
+            write_len += node->len;
+            break;
+
+        case CMD_READ:
+            if (starts == 0 || expect_address || !(addresses[starts - 1] & 1) ||
+                    read_count == SHIM_MAX_READS || read_len + node->len > sizeof(read_data)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            reads[read_count++] = node;
+            read_len += node->len;
+            break;
+
+        case CMD_STOP:
+            break;
+        }
+    }
+
+    int ret;
+    uint8_t address = addresses[0] >> 1;
+    bool first_is_read = starts > 0 && (addresses[0] & 1);
+    if (starts == 1 && !first_is_read) {
+        ret = write_len == 0 ? sim_i2c_probe(i2c_num, address) : sim_i2c_write(i2c_num, address, write_data, write_len);
+    } else if (starts == 1) {
+        ret = sim_i2c_read(i2c_num, address, read_data, read_len);
+    } else if (starts == 2 && !first_is_read && addresses[1] == (addresses[0] | 1)) {
+        ret = sim_i2c_write_read(i2c_num, address, write_data, write_len, read_data, read_len,
+                                 ticks_to_wait * portTICK_PERIOD_MS);
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (ret == HTU21D_ERR_OK) {
+        size_t offset = 0;
+        for (int i = 0; i < read_count; i++) {
+            memcpy(reads[i]->read_data, read_data + offset, reads[i]->len);
+            offset += reads[i]->len;
+        }
+    }
+    return to_esp_err(ret);
+}
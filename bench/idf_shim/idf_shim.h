@@ -0,0 +1,27 @@
+/**
+ * @file idf_shim.h
+ * @brief Hooks into the host stand-in of ESP-IDF, for benchmarks.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __IDF_SHIM_H__
+#define __IDF_SHIM_H__
+
+/**
+ * @brief Runs while the calling task is blocked, in i2c_master_cmd_begin()
+ * and vTaskDelay().
+ *
+ * Stands in for the other tasks the scheduler would run meanwhile, e.g. to
+ * interleave their heap use with the driver's.
+ */
+typedef void (*idf_shim_blocked_hook_t)(void);
+
+/**
+ * @brief Installs (or removes with `NULL`) the blocked task hook.
+ */
+void idf_shim_set_blocked_hook(idf_shim_blocked_hook_t hook);
+
+#endif  // __IDF_SHIM_H__
@@ -0,0 +1,21 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the generated ESP-IDF project configuration.
+ *
+ * Matches a default ESP-IDF project with this component's options enabled.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#define CONFIG_FREERTOS_HZ 100
+#ifndef CONFIG_HTU21D_DERIVED_MATH
+#define CONFIG_HTU21D_DERIVED_MATH 1
+#endif
+#ifndef CONFIG_HTU21D_LOGGING
+#define CONFIG_HTU21D_LOGGING 1
+#endif
+#ifndef CONFIG_HTU21D_SPECTRUM
+#define CONFIG_HTU21D_SPECTRUM 1
+#endif
@@ -0,0 +1,417 @@
+/**
+ * @file sim_bus.c
+ * @brief Timing-accurate simulated I2C bus and HTU21D sensors for host
+ * benchmarks.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdbool.h>
+#include "sim_bus.h"
+
+#define SIM_BIT_US          10    /**< One SCL period at 100 kHz. */
+#define SIM_SOFT_RESET_US   15000 /**< Soft reset time from the datasheet. */
+#define SIM_MAX_SENSORS     128
+#define SIM_MAX_MUXES       16
+
+/**
+ * @brief Typical conversion times (us) from the datasheet, indexed by the
+ * user register resolution bits (bit 7 << 1 | bit 0).
+ */
+static const uint32_t _temperature_us[4] = {44000, 11000, 22000, 6000};
+static const uint32_t _humidity_us[4] = {14000, 2000, 4000, 7000};
+
+/**
+ * @brief Maximum conversion times (us) from the datasheet, for sim_set_jitter().
+ */
+static const uint32_t _temperature_max_us[4] = {50000, 13000, 25000, 7000};
+static const uint32_t _humidity_max_us[4] = {16000, 3000, 5000, 8000};
+
+/**
+ * @brief Measurement resolution in bits, indexed like the tables above.
+ */
+static const uint8_t _temperature_bits[4] = {14, 12, 13, 11};
+static const uint8_t _humidity_bits[4] = {12, 8, 10, 11};
+
+/**
+ * @brief State of the simulated sensor.
+ */
+typedef struct {
+    i2c_port_t port;
+    uint8_t mux_address;        /**< Mux the sensor is behind, or #HTU21D_NO_MUX. */
+    uint8_t mux_channel;
+    uint8_t user_register;
+    uint8_t command;            /**< Last command byte received. */
+    bool measuring;             /**< A measurement was triggered and not read yet. */
+    uint64_t busy_until_us;     /**< End of the running conversion or reset. */
+} sim_sensor_t;
+
+/**
+ * @brief State of a simulated TCA9548A mux.
+ */
+typedef struct {
+    i2c_port_t port;
+    uint8_t address;
+    uint8_t channels;           /**< Control register, one bit per enabled channel. */
+} sim_mux_t;
+
+static uint64_t _now_us;
+static sim_stats_t _stats;
+static sim_sensor_t _sensors[SIM_MAX_SENSORS];
+static int _sensor_count;
+static sim_mux_t _muxes[SIM_MAX_MUXES];
+static int _mux_count;
+static sim_observer_t _observer;
+static uint16_t _raw_temperature;
+static uint16_t _raw_humidity;
+static bool _jitter;
+static uint32_t _rng;
+
+static void observe(sim_op_t op)
+{
+    if (_observer != NULL) {
+        _observer(op);
+    }
+}
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Conversion time, typical or with jitter anywhere up to the maximum.
+ */
+static uint32_t conversion_us(uint32_t typical_us, uint32_t max_us)
+{
+    if (!_jitter) {
+        return typical_us;
+    }
+    _rng = _rng * 1664525 + 1013904223;
+    return typical_us + (_rng >> 8) % (max_us - typical_us + 1);
+}
+
+static int resolution_index(const sim_sensor_t *sensor)
+{
+    return ((sensor->user_register >> 6) & 0x02) | (sensor->user_register & 0x01);
+}
+
+static sim_mux_t *find_mux(i2c_port_t port, uint8_t address)
+{
+    for (int i = 0; i < _mux_count; i++) {
+        if (_muxes[i].port == port && _muxes[i].address == address) {
+            return &_muxes[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the one sensor that sees a transaction to #HTU21D_ADDR on
+ * `port`, or `NULL` if none does. Sensors on enabled mux channels all see it,
+ * more than one counts as a conflict and the first one answers.
+ */
+static sim_sensor_t *addressed_sensor(i2c_port_t port)
+{
+    sim_sensor_t *found = NULL;
+
+    for (int i = 0; i < _sensor_count; i++) {
+        sim_sensor_t *sensor = &_sensors[i];
+        if (sensor->port != port) {
+            continue;
+        }
+        if (sensor->mux_address != HTU21D_NO_MUX) {
+            sim_mux_t *mux = find_mux(port, sensor->mux_address);
+            if (!(mux->channels & (1 << sensor->mux_channel))) {
+                continue;
+            }
+        }
+        if (found != NULL) {
+            _stats.conflicts++;
+            continue;
+        }
+        found = sensor;
+    }
+    return found;
+}
+
+/**
+ * @brief Advances the clock by the wire time of a transaction.
+ */
+static void bus_time(size_t bytes, bool repeated_start)
+{
+    // START + address and payload bytes (9 bits each with ACK) + STOP
+    uint64_t us = (2 + 9 * (bytes + (repeated_start ? 2 : 1)) + (repeated_start ? 1 : 0)) * SIM_BIT_US;
+
+    _now_us += us;
+    _stats.bus_us += us;
+    _stats.transactions++;
+}
+
+/**
+ * @brief The sensor does not ACK its address while converting or resetting.
+ */
+static bool sensor_busy(const sim_sensor_t *sensor)
+{
+    return _now_us < sensor->busy_until_us;
+}
+
+static void sensor_write(sim_sensor_t *sensor, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    sensor->command = data[0];
+    switch (data[0]) {
+
+    case WRITE_USER_REG:
+        if (len == 2) {
+            // only the resolution, heater and OTP bits are writable
+            sensor->user_register = (sensor->user_register & 0x38) | (data[1] & 0xC7);
+        }
+        break;
+
+    case SOFT_RESET:
+        sensor->user_register = 0x02;
+        sensor->measuring = false;
+        sensor->busy_until_us = _now_us + SIM_SOFT_RESET_US;
+        break;
+
+    case TRIGGER_TEMP_MEASURE_HOLD:
+    case TRIGGER_TEMP_MEASURE_NOHOLD:
+        sensor->measuring = true;
+        sensor->busy_until_us = _now_us + conversion_us(_temperature_us[resolution_index(sensor)],
+                                _temperature_max_us[resolution_index(sensor)]);
+        break;
+
+    case TRIGGER_HUMD_MEASURE_HOLD:
+    case TRIGGER_HUMD_MEASURE_NOHOLD:
+        sensor->measuring = true;
+        sensor->busy_until_us = _now_us + conversion_us(_humidity_us[resolution_index(sensor)],
+                                _humidity_max_us[resolution_index(sensor)]);
+        break;
+    }
+}
+
+static void sensor_read(sim_sensor_t *sensor, uint8_t *data, size_t len)
+{
+    uint8_t answer[3] = {0};
+
+    if (sensor->command == READ_USER_REG) {
+        answer[0] = sensor->user_register;
+    } else if (sensor->measuring) {
+        bool is_temperature = sensor->command == TRIGGER_TEMP_MEASURE_HOLD ||
+                              sensor->command == TRIGGER_TEMP_MEASURE_NOHOLD;
+        uint8_t bits = is_temperature ? _temperature_bits[resolution_index(sensor)]
+                       : _humidity_bits[resolution_index(sensor)];
+        uint16_t raw = is_temperature ? _raw_temperature : _raw_humidity;
+
+        raw &= (uint16_t)(0xFFFF << (16 - bits)) & 0xFFFC;
+        raw |= is_temperature ? 0x00 : 0x02;
+        answer[0] = raw >> 8;
+        answer[1] = raw & 0xFF;
+        answer[2] = crc8(answer, 2);
+        sensor->measuring = false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        data[i] = i < sizeof(answer) ? answer[i] : 0xFF;
+    }
+}
+
+void sim_reset(void)
+{
+    _now_us = 0;
+    _stats = (sim_stats_t) {
+        0
+    };
+    _sensor_count = 0;
+    _mux_count = 0;
+    _raw_temperature = 0x6658;  // ~23.4 degC
+    _raw_humidity = 0x7C80;     // ~54.8 %RH
+    _jitter = false;
+    _rng = 12345;
+}
+
+int sim_add_sensor(i2c_port_t port, uint8_t mux_address, uint8_t mux_channel)
+{
+    if (_sensor_count == SIM_MAX_SENSORS) {
+        return -1;
+    }
+    if (mux_address != HTU21D_NO_MUX && find_mux(port, mux_address) == NULL) {
+        if (_mux_count == SIM_MAX_MUXES) {
+            return -1;
+        }
+        _muxes[_mux_count++] = (sim_mux_t) {
+            .port = port,
+            .address = mux_address,
+            .channels = 0x00,
+        };
+    }
+    _sensors[_sensor_count] = (sim_sensor_t) {
+        .port = port,
+        .mux_address = mux_address,
+        .mux_channel = mux_channel,
+        .user_register = 0x02,
+    };
+    return _sensor_count++;
+}
+
+uint64_t sim_now_us(void)
+{
+    return _now_us;
+}
+
+void sim_advance_ms(uint32_t ms)
+{
+    _now_us += (uint64_t) ms * 1000;
+}
+
+sim_stats_t sim_stats(void)
+{
+    return _stats;
+}
+
+void sim_set_observer(sim_observer_t observer)
+{
+    _observer = observer;
+}
+
+void sim_set_jitter(bool enabled)
+{
+    _jitter = enabled;
+}
+
+void sim_set_raw(uint16_t raw_temperature, uint16_t raw_humidity)
+{
+    _raw_temperature = raw_temperature;
+    _raw_humidity = raw_humidity;
+}
+
+int sim_i2c_bus_config(i2c_port_t port)
+{
+    observe(SIM_OP_BUS_CONFIG);
+    (void) port;
+    return HTU21D_ERR_OK;
+}
+
+int sim_i2c_bus_install(i2c_port_t port)
+{
+    observe(SIM_OP_BUS_INSTALL);
+    (void) port;
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Handles a write to a mux's control register, if `address` is one.
+ */
+static bool mux_write(i2c_port_t port, uint8_t address, const uint8_t *data, size_t len)
+{
+    sim_mux_t *mux = find_mux(port, address);
+    if (mux == NULL) {
+        return false;
+    }
+    bus_time(len, false);
+    if (len > 0) {
+        mux->channels = data[len - 1];
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the sensor answering a transaction, or `NULL` after
+ * accounting for the NACKed address byte.
+ */
+static sim_sensor_t *start_transaction(i2c_port_t port, uint8_t address)
+{
+    sim_sensor_t *sensor = address == HTU21D_ADDR ? addressed_sensor(port) : NULL;
+    if (sensor == NULL || sensor_busy(sensor)) {
+        bus_time(0, false);
+        _stats.nacks++;
+        return NULL;
+    }
+    return sensor;
+}
+
+int sim_i2c_probe(i2c_port_t port, uint8_t address)
+{
+    observe(SIM_OP_PROBE);
+    if (find_mux(port, address) != NULL) {
+        bus_time(0, false);
+        return HTU21D_ERR_OK;
+    }
+    if (start_transaction(port, address) == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    bus_time(0, false);
+    return HTU21D_ERR_OK;
+}
+
+int sim_i2c_write(i2c_port_t port, uint8_t address, const uint8_t *data, size_t len)
+{
+    observe(SIM_OP_WRITE);
+    if (mux_write(port, address, data, len)) {
+        return HTU21D_ERR_OK;
+    }
+    sim_sensor_t *sensor = start_transaction(port, address);
+    if (sensor == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    bus_time(len, false);
+    sensor_write(sensor, data, len);
+    return HTU21D_ERR_OK;
+}
+
+int sim_i2c_read(i2c_port_t port, uint8_t address, uint8_t *data, size_t len)
+{
+    observe(SIM_OP_READ);
+    sim_sensor_t *sensor = start_transaction(port, address);
+    if (sensor == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    bus_time(len, false);
+    sensor_read(sensor, data, len);
+    return HTU21D_ERR_OK;
+}
+
+int sim_i2c_write_read(i2c_port_t port, uint8_t address,
+                       const uint8_t *write_data, size_t write_len,
+                       uint8_t *read_data, size_t read_len,
+                       uint32_t timeout_ms)
+{
+    observe(SIM_OP_WRITE_READ);
+    sim_sensor_t *sensor = start_transaction(port, address);
+    if (sensor == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    bus_time(write_len + read_len, true);
+    sensor_write(sensor, write_data, write_len);
+
+    // hold master mode: the sensor stretches SCL until the conversion is done
+    if (sensor_busy(sensor)) {
+        uint64_t stretch_us = sensor->busy_until_us - _now_us;
+        if (stretch_us > (uint64_t) timeout_ms * 1000) {
+            _now_us += (uint64_t) timeout_ms * 1000;
+            _stats.bus_us += (uint64_t) timeout_ms * 1000;
+            return HTU21D_ERR_TIMEOUT;
+        }
+        _now_us += stretch_us;
+        _stats.bus_us += stretch_us;
+    }
+    sensor_read(sensor, read_data, read_len);
+    return HTU21D_ERR_OK;
+}
+
+void sim_delay_ms(uint32_t ms)
+{
+    observe(SIM_OP_DELAY);
+    _now_us += (uint64_t) ms * 1000;
+    _stats.delay_us += (uint64_t) ms * 1000;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file sim_bus.h
+ * @brief Timing-accurate simulated I2C bus and HTU21D sensors for host
+ * benchmarks.
+ *
+ * Simulates 100 kHz I2C buses with HTU21D sensors on a virtual clock, so
+ * benchmarks run instantly and deterministically on a Linux box with no
+ * hardware. The `sim_i2c_*` functions are the bus transactions; sim_port.c
+ * maps the `htu21d_port_*` layer straight onto them, and idf_shim/ runs the
+ * ESP-IDF port's command links on them.
+ *
+ * - Every transaction advances the clock by its wire time (START, 9 bits per
+ *   byte including ACK, repeated START, STOP).
+ * - Measurements take the datasheet's typical conversion time for the active
+ *   resolution, or with sim_set_jitter() anything up to the maximum. Reading
+ *   a no-hold measurement early is NACKed like on the real part, and
+ *   hold-master reads stretch the clock until it's done.
+ * - Soft reset keeps the sensor busy for 15 ms.
+ * - sim_delay_ms(), behind htu21d_port_delay_ms() and vTaskDelay(), advances
+ *   the clock instead of sleeping.
+ * - Sensors can sit on any bus, straight on it or behind TCA9548A muxes.
+ *   Every sensor on an enabled mux channel sees a transaction, so two
+ *   answering at once is counted as a conflict.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __SIM_BUS_H__
+#define __SIM_BUS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief Bus activity recorded since the last sim_reset().
+ */
+typedef struct {
+    unsigned transactions;  /**< START...STOP sequences put on the bus. */
+    unsigned nacks;         /**< Transactions NACKed by the sensor (busy or absent). */
+    unsigned conflicts;     /**< Transactions more than one sensor answered. */
+    uint64_t bus_us;        /**< Time the bus was occupied, clock stretching included. */
+    uint64_t delay_us;      /**< Time spent in sim_delay_ms(). */
+} sim_stats_t;
+
+/**
+ * @brief Bus entry points, reported to the observer.
+ */
+typedef enum {
+    SIM_OP_BUS_CONFIG,
+    SIM_OP_BUS_INSTALL,
+    SIM_OP_PROBE,
+    SIM_OP_WRITE,
+    SIM_OP_READ,
+    SIM_OP_WRITE_READ,
+    SIM_OP_DELAY,
+} sim_op_t;
+
+/**
+ * @brief Called on entry of every `sim_i2c_*` function, before the clock
+ * advances.
+ *
+ * Lets benchmarks split a single driver call (e.g. htu21d_init()) into phases.
+ */
+typedef void (*sim_observer_t)(sim_op_t op);
+
+/**
+ * @brief Resets the clock and statistics and removes all sensors and muxes.
+ */
+void sim_reset(void);
+
+/**
+ * @brief Adds a sensor in power-on state, creating its mux if needed.
+ * @param port Bus the sensor (or its mux) is on.
+ * @param mux_address Mux the sensor is behind, or #HTU21D_NO_MUX.
+ * @param mux_channel Mux channel (0-7) the sensor is on.
+ * @return Returns the sensor index, or `-1` if the simulation is full.
+ */
+int sim_add_sensor(i2c_port_t port, uint8_t mux_address, uint8_t mux_channel);
+
+/**
+ * @brief Returns the virtual clock in microseconds since sim_reset().
+ */
+uint64_t sim_now_us(void);
+
+/**
+ * @brief Lets `ms` milliseconds pass without counting them as a delay.
+ */
+void sim_advance_ms(uint32_t ms);
+
+/**
+ * @brief Returns the statistics recorded since the last sim_reset().
+ */
+sim_stats_t sim_stats(void);
+
+/**
+ * @brief Makes every conversion take a pseudo-random time between the
+ * datasheet's typical and maximum, like real parts do, instead of exactly the
+ * typical time. The sequence restarts on sim_reset().
+ */
+void sim_set_jitter(bool enabled);
+
+/**
+ * @brief Sets the raw codes all sensors convert to (status bits are added).
+ */
+void sim_set_raw(uint16_t raw_temperature, uint16_t raw_humidity);
+
+/**
+ * @brief Installs (or removes with `NULL`) the bus entry observer.
+ */
+void sim_set_observer(sim_observer_t observer);
+
+// Bus transactions, returning `HTU21D_ERR_*` codes like the port layer.
+int sim_i2c_bus_config(i2c_port_t port);
+int sim_i2c_bus_install(i2c_port_t port);
+int sim_i2c_probe(i2c_port_t port, uint8_t address);
+int sim_i2c_write(i2c_port_t port, uint8_t address, const uint8_t *data, size_t len);
+int sim_i2c_read(i2c_port_t port, uint8_t address, uint8_t *data, size_t len);
+int sim_i2c_write_read(i2c_port_t port, uint8_t address,
+                       const uint8_t *write_data, size_t write_len,
+                       uint8_t *read_data, size_t read_len,
+                       uint32_t timeout_ms);
+void sim_delay_ms(uint32_t ms);
+
+#endif  // __SIM_BUS_H__
@@ -0,0 +1,66 @@
+/**
+ * @file sim_port.c
+ * @brief HTU21D transport layer on the simulated bus, for host benchmarks.
+ *
+ * Maps every `htu21d_port_*` function one to one onto a `sim_i2c_*`
+ * transaction, like the Linux i2c-dev port does onto `I2C_RDWR`.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include "htu21d_port.h"
+#include "sim_bus.h"
+
+int htu21d_port_bus_config(i2c_port_t port, int sda_pin, int scl_pin,
+                           gpio_pullup_t sda_internal_pullup,
+                           gpio_pullup_t scl_internal_pullup)
+{
+    (void) sda_pin;
+    (void) scl_pin;
+    (void) sda_internal_pullup;
+    (void) scl_internal_pullup;
+    return sim_i2c_bus_config(port);
+}
+
+int htu21d_port_bus_install(i2c_port_t port)
+{
+    return sim_i2c_bus_install(port);
+}
+
+int htu21d_port_probe(i2c_port_t port, uint8_t address, uint32_t timeout_ms)
+{
+    (void) timeout_ms;
+    return sim_i2c_probe(port, address);
+}
+
+int htu21d_port_write(i2c_port_t port, uint8_t address, const uint8_t *data,
+                      size_t len, uint32_t timeout_ms)
+{
+    (void) timeout_ms;
+    return sim_i2c_write(port, address, data, len);
+}
+
+int htu21d_port_read(i2c_port_t port, uint8_t address, uint8_t *data,
+                     size_t len, uint32_t timeout_ms)
+{
+    (void) timeout_ms;
+    return sim_i2c_read(port, address, data, len);
+}
+
+int htu21d_port_write_read(i2c_port_t port, uint8_t address,
+                           const uint8_t *write_data, size_t write_len,
+                           uint8_t *read_data, size_t read_len,
+                           uint32_t timeout_ms)
+{
+    return sim_i2c_write_read(port, address, write_data, write_len, read_data, read_len, timeout_ms);
+}
+
+void htu21d_port_delay_ms(uint32_t ms)
+{
+    sim_delay_ms(ms);
+}
+
+uint64_t htu21d_port_time_us(void)
+{
+    return sim_now_us();
+}
@@ -0,0 +1,74 @@
+/**
+ * @file htu21d_heap_profile.c
+ * @brief Heap profile of the HTU21D driver on a device, with the IDF heap
+ * tracing API.
+ *
+ * First traces every heap allocation made during a few samples, then keeps
+ * sampling forever and logs free heap, largest free block and fragmentation
+ * every #REPORT_EVERY samples. The host equivalent is bench/bench_heap.c.
+ * @author Rob4226 <Rob4226@yahoo.com>
+ * @copyright MIT License 2023
+ */
+
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_trace.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "htu21d.h"
+
+#define TRACE_SAMPLES   10      /**< Samples taken while tracing every allocation. */
+#define TRACE_RECORDS   200
+#define REPORT_EVERY    10000   /**< Samples between heap reports, about 8 minutes. */
+
+static const char *TAG = "HEAP_PROFILE";
+
+static heap_trace_record_t trace_records[TRACE_RECORDS];
+
+static uint16_t take_sample(uint32_t sample)
+{
+    return read_value(sample % 2 ? TRIGGER_TEMP_MEASURE_NOHOLD : TRIGGER_HUMD_MEASURE_NOHOLD);
+}
+
+static void log_heap(uint32_t samples)
+{
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    ESP_LOGI(TAG, "%u samples: free %u, largest block %u, fragmentation %.1f%%, minimum free %u",
+             (unsigned) samples, (unsigned) free_bytes, (unsigned) largest,
+             free_bytes ? 100.0 * (1.0 - (double) largest / free_bytes) : 0.0,
+             (unsigned) heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+}
+
+void app_main(void)
+{
+    ESP_ERROR_CHECK(
+        htu21d_init(I2C_NUM_0, 1, 2, GPIO_PULLUP_ENABLE, GPIO_PULLUP_ENABLE));
+    ESP_ERROR_CHECK(heap_trace_init_standalone(trace_records, TRACE_RECORDS));
+
+    // record every allocation made while sampling
+    ESP_ERROR_CHECK(heap_trace_start(HEAP_TRACE_ALL));
+    for (uint32_t sample = 1; sample <= TRACE_SAMPLES; sample++) {
+        take_sample(sample);
+    }
+    ESP_ERROR_CHECK(heap_trace_stop());
+
+    size_t allocations = heap_trace_get_count();
+    ESP_LOGI(TAG, "%.2f heap allocations per sample%s", (double) allocations / TRACE_SAMPLES,
+             allocations == TRACE_RECORDS ? " (or more, trace buffer full)" : "");
+    if (allocations > 0) {
+        heap_trace_dump();
+    }
+
+    log_heap(0);
+    for (uint32_t sample = 1;; sample++) {
+        if (take_sample(sample) == 0) {
+            ESP_LOGW(TAG, "Sample %u failed", (unsigned) sample);
+        }
+        if (sample % REPORT_EVERY == 0) {
+            log_heap(sample);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * @file htu21d_noise_sweep.c
+ * @brief Noise versus latency and energy of every resolution and
+ * oversampling count, measured on a real HTU21D.
+ *
+ * For every resolution, takes #SAMPLES back to back temperature and then
+ * humidity conversions and prints:
+ *
+ * - every raw code as a `trace,<resolution>,<T|RH>,<raw>` line, which
+ *   tools/noise_sweep.py analyzes the same way on a host,
+ * - per oversampling count (averaging 1-16 conversions) the noise, the
+ *   latency and the energy of one reading.
+ *
+ * Noise is the standard deviation of consecutive readings' differences
+ * divided by sqrt(2), so slow room drift during the sweep doesn't count as
+ * noise. Keep the sensor in still air for the ~70 s the sweep takes.
+ * @author Rob4226 <Rob4226@yahoo.com>
+ * @copyright MIT License 2023
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "htu21d.h"
+
+#define SAMPLES             512     /**< Conversions per resolution and channel. */
+#define MAX_OVERSAMPLING    16
+#define SUPPLY_V            3.0     /**< Typical supply voltage. */
+#define MEASURING_MA        0.45    /**< Typical supply current while measuring, from the datasheet. */
+
+static const char *TAG = "NOISE_SWEEP";
+
+static const uint8_t resolutions[] = {0x00, 0x01, 0x80, 0x81};
+
+static uint16_t raw[SAMPLES];
+
+/**
+ * @brief Noise of the mean of `oversampling` consecutive raw codes, in raw
+ * code units, from the differences of consecutive means.
+ */
+static double noise(int oversampling)
+{
+    int readings = SAMPLES / oversampling;
+    double previous = 0, sum = 0, sum_squares = 0;
+
+    for (int r = 0; r < readings; r++) {
+        double mean = 0;
+        for (int i = 0; i < oversampling; i++) {
+            mean += raw[r * oversampling + i];
+        }
+        mean /= oversampling;
+        if (r > 0) {
+            double diff = mean - previous;
+            sum += diff;
+            sum_squares += diff * diff;
+        }
+        previous = mean;
+    }
+    int diffs = readings - 1;
+    double variance = (sum_squares - sum * sum / diffs) / (diffs - 1);
+    return sqrt(variance > 0 ? variance / 2 : 0);
+}
+
+static void sweep(uint8_t resolution, uint8_t command)
+{
+    const char *channel = command == TRIGGER_TEMP_MEASURE_NOHOLD ? "T" : "RH";
+    double unit = command == TRIGGER_TEMP_MEASURE_NOHOLD ? 175.72 / 65536 : 125.0 / 65536;
+    uint32_t conversion_ms = htu21d_conversion_time_ms(resolution, command);
+
+    for (int i = 0; i < SAMPLES; i++) {
+        raw[i] = read_value(command);
+        printf("trace,0x%02X,%s,%u\n", resolution, channel, raw[i]);
+    }
+
+    for (int oversampling = 1; oversampling <= MAX_OVERSAMPLING; oversampling *= 2) {
+        uint32_t latency_ms = oversampling * conversion_ms;
+        printf("result,0x%02X,%s,%d,%.4f,%u,%.1f\n", resolution, channel, oversampling,
+               noise(oversampling) * unit, (unsigned) latency_ms, SUPPLY_V * MEASURING_MA * latency_ms);
+    }
+}
+
+void app_main(void)
+{
+    ESP_ERROR_CHECK(
+        htu21d_init(I2C_NUM_0, 1, 2, GPIO_PULLUP_ENABLE, GPIO_PULLUP_ENABLE));
+
+    for (size_t r = 0; r < sizeof(resolutions); r++) {
+        ESP_ERROR_CHECK(htu21d_set_resolution(resolutions[r]));
+        sweep(resolutions[r], TRIGGER_TEMP_MEASURE_NOHOLD);
+        sweep(resolutions[r], TRIGGER_HUMD_MEASURE_NOHOLD);
+    }
+
+    ESP_LOGI(TAG, "Result columns: resolution, channel, oversampling, noise (degC or %%RH), "
+             "latency (ms), energy (uJ). Save the log and run tools/noise_sweep.py on it for a table.");
+    ESP_ERROR_CHECK(htu21d_set_resolution(0x00));
+}
@@ -10,18 +10,251 @@
  * @date 10.8.2017, 11.29.2023
  */
 
-#include <math.h>
-#include "esp_log.h"
 #include "htu21d.h"
+#include "htu21d_port.h"
+#if CONFIG_HTU21D_DERIVED_MATH
+#include <math.h>
+#endif
 
 #define HTU21_TEMPERATURE_COEFFICIENT   (-0.15F)   /**< Used in equation to convert Measured Relative Humidity to Temperature Compensated Relative Humidity. */
 #define HTU21_CONSTANT_A                (8.1332F)  /**< Constant `A` used in Partial Pressure from Ambient Temperature formula. */
 #define HTU21_CONSTANT_B                (1762.39F) /**< Constant `B` used in Partial Pressure from Ambient Temperature formula. */
 #define HTU21_CONSTANT_C                (235.66F)  /**< Constant `C` used in Partial Pressure from Ambient Temperature formula. */
+#define HTU21D_LOG2_10                  (3.32192809F) /**< `10^x == 2^(x * log2(10))`, exp2f() being cheaper than powf(). */
+#define HTU21D_KPA_PER_MMHG             (0.133322387F)
+#define HTU21D_WATER_AIR_MASS_RATIO     (0.621945F) /**< Molar mass of water vapor over that of dry air. */
+
+#define HTU21D_I2C_TIMEOUT_MS           1000       /**< Timeout of every I2C transaction. */
+#define HTU21D_POLL_INTERVAL_MS         1          /**< Time between polls in #HTU21D_READ_MODE_POLLING. */
+#define HTU21D_PROBE_TIMEOUT_MS         10         /**< Timeout of the probes of a sensor that kept failing. */
+#define HTU21D_BACKOFF_MIN_MS           100        /**< First wait before probing a sensor that kept failing. */
+#define HTU21D_BACKOFF_MAX_MS           60000      /**< Longest wait between probes. */
+#define HTU21D_RESOLUTION_MASK          0b10000001 /**< Resolution bits of the user register. */
+#define HTU21D_MEASURING_UJ_PER_MS      (3.0F * 0.45F) /**< Sensor energy while converting: 3.0 V x 450 uA typical. */
+#define HTU21D_SQRT1_2                  0.70710678F /**< Noise factor of doubling the oversampling. */
+
+#define HTU21D_USER_REGISTER_DEFAULT    0x02       /**< User register after power-on or soft reset. */
+#define HTU21D_USER_REGISTER_BATTERY    0x40       /**< End of battery bit, VDD < 2.25 V. */
+#define HTU21D_USER_REGISTER_HEATER     0x04       /**< On-chip heater enable bit. */
+#define HTU21D_SAMPLE_RETRIES           1          /**< Repeats of a sample's conversion after a CRC error. */
+
+// raw code limits of the physical range, so samples are checked without floats
+#define HTU21D_RAW_TEMPERATURE_MIN      2555       /**< -40 degC. */
+#define HTU21D_RAW_TEMPERATURE_MAX      64093      /**< 125 degC. */
+#define HTU21D_RAW_HUMIDITY_MIN         3146       /**< 0 %RH. */
+#define HTU21D_RAW_HUMIDITY_MAX         55574      /**< 100 %RH. */
+
+// htu21d_sample_t::converted bits
+#define HTU21D_CONVERTED_TEMPERATURE    0x01
+#define HTU21D_CONVERTED_HUMIDITY       0x02
+#define HTU21D_CONVERTED_COMPENSATED    0x04
+#define HTU21D_CONVERTED_DEW_POINT      0x08
 
 static const char* TAG = "htu21d_driver";
 
-static i2c_port_t _port = 0; /**< The I2C port that the HTU21D sensor is connected to. */
+/**
+ * @brief Datasheet conversion times in ms, indexed by resolution (user
+ * register bit 7 << 1 | bit 0).
+ */
+typedef struct {
+    uint8_t typical_ms;
+    uint8_t max_ms;
+} htu21d_conversion_time_t;
+
+static const htu21d_conversion_time_t _temperature_time[4] = {{44, 50}, {11, 13}, {22, 25}, {6, 7}};
+static const htu21d_conversion_time_t _humidity_time[4] = {{14, 16}, {2, 3}, {4, 5}, {7, 8}};
+
+/**
+ * @brief Single conversion noise used by htu21d_plan() when the application
+ * has no measured figures: the datasheet's resolution for 14/12-bit and
+ * 12/8-bit, the other resolutions scaled by their bit count.
+ */
+static const htu21d_noise_t _datasheet_noise[HTU21D_RESOLUTIONS] = {
+    {0x00, 0.01F, 0.04F},
+    {0x01, 0.04F, 0.7F},
+    {0x80, 0.02F, 0.16F},
+    {0x81, 0.08F, 0.08F},
+};
+
+/**
+ * @brief Mux channel currently enabled on a bus.
+ */
+typedef struct {
+    bool used;
+    bool known;           /**< False until the driver selected a channel itself. */
+    i2c_port_t port;
+    uint8_t mux_address;  /**< Mux with a channel enabled, or #HTU21D_NO_MUX. */
+    uint8_t mux_channel;
+} htu21d_bus_state_t;
+
+static htu21d_bus_state_t _buses[HTU21D_MAX_BUSES];
+
+static htu21d_dev_t _dev = {0}; /**< The sensor behind the functions that don't take a device. */
+
+static int read_averaged(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value);
+
+static bool is_humidity(uint8_t command)
+{
+    return command == TRIGGER_HUMD_MEASURE_HOLD || command == TRIGGER_HUMD_MEASURE_NOHOLD;
+}
+
+static const htu21d_conversion_time_t *conversion_time(uint8_t resolution, uint8_t command)
+{
+    int index = ((resolution >> 6) & 0x02) | (resolution & 0x01);
+
+    if (is_humidity(command)) {
+        return &_humidity_time[index];
+    }
+    return &_temperature_time[index];
+}
+
+static htu21d_bus_state_t *bus_state(i2c_port_t port)
+{
+    htu21d_bus_state_t *unused = NULL;
+
+    for (int i = 0; i < HTU21D_MAX_BUSES; i++) {
+        if (_buses[i].used && _buses[i].port == port) {
+            return &_buses[i];
+        }
+        if (!_buses[i].used && unused == NULL) {
+            unused = &_buses[i];
+        }
+    }
+    if (unused != NULL) {
+        unused->used = true;
+        unused->known = false;
+        unused->port = port;
+        unused->mux_address = HTU21D_NO_MUX;
+    }
+    return unused;
+}
+
+/**
+ * @brief Routes the bus to the device's mux channel.
+ *
+ * Only one channel is kept open per bus, since every HTU21D answers at the
+ * same address. Nothing is sent if the right channel is already selected.
+ */
+static int select_dev_timeout(htu21d_dev_t *dev, uint32_t timeout_ms)
+{
+    htu21d_bus_state_t *bus = bus_state(dev->port);
+    if (bus == NULL) {
+        HTU21D_LOGE(TAG, "More than %d buses in use", HTU21D_MAX_BUSES);
+        return HTU21D_ERR_INVALID_STATE;
+    }
+    if (bus->mux_address == dev->mux_address &&
+            (dev->mux_address == HTU21D_NO_MUX || (bus->known && bus->mux_channel == dev->mux_channel))) {
+        return HTU21D_ERR_OK;
+    }
+
+    // close the channel of another mux first
+    if (bus->known && bus->mux_address != HTU21D_NO_MUX && bus->mux_address != dev->mux_address) {
+        uint8_t none = 0x00;
+        int ret = htu21d_port_write(dev->port, bus->mux_address, &none, 1, timeout_ms);
+        if (ret != HTU21D_ERR_OK) {
+            return ret;
+        }
+        bus->mux_address = HTU21D_NO_MUX;
+    }
+
+    if (dev->mux_address != HTU21D_NO_MUX) {
+        uint8_t channel = 1 << dev->mux_channel;
+        int ret = htu21d_port_write(dev->port, dev->mux_address, &channel, 1, timeout_ms);
+        if (ret != HTU21D_ERR_OK) {
+            return ret;
+        }
+        bus->known = true;
+        bus->mux_address = dev->mux_address;
+        bus->mux_channel = dev->mux_channel;
+    }
+    return HTU21D_ERR_OK;
+}
+
+static int select_dev(htu21d_dev_t *dev)
+{
+    return select_dev_timeout(dev, HTU21D_I2C_TIMEOUT_MS);
+}
+
+/**
+ * @brief Schedules the next probe of a sensor that kept failing, doubling
+ * the wait if `longer`.
+ */
+static void back_off(htu21d_dev_t *dev, bool longer)
+{
+    if (longer) {
+        dev->backoff_ms = dev->backoff_ms < HTU21D_BACKOFF_MAX_MS / 2 ? dev->backoff_ms * 2 : HTU21D_BACKOFF_MAX_MS;
+    }
+    dev->retry_us = htu21d_port_time_us() + dev->backoff_ms * 1000ULL;
+}
+
+/**
+ * @brief Decides whether a measurement may touch the bus (circuit breaker).
+ *
+ * Once htu21d_dev_t::breaker_threshold measurements in a row failed, the
+ * sensor is left alone until htu21d_dev_t::retry_us, then probed with a
+ * short timeout. A failed probe doubles the wait, a successful one lets the
+ * measurement through.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_UNAVAILABLE.
+ */
+static int breaker_check(htu21d_dev_t *dev)
+{
+    if (dev->breaker_threshold == 0 || dev->failures < dev->breaker_threshold) {
+        return HTU21D_ERR_OK;
+    }
+    uint64_t now_us = htu21d_port_time_us();
+    if (now_us < dev->retry_us) {
+        return HTU21D_ERR_UNAVAILABLE;
+    }
+
+    int ret = select_dev_timeout(dev, HTU21D_PROBE_TIMEOUT_MS);
+    if (ret == HTU21D_ERR_OK) {
+        ret = htu21d_port_probe(dev->port, HTU21D_ADDR, HTU21D_PROBE_TIMEOUT_MS);
+    }
+    if (ret != HTU21D_ERR_OK) {
+        back_off(dev, true);
+        return HTU21D_ERR_UNAVAILABLE;
+    }
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Counts the outcome of a measurement for breaker_check(). A CRC
+ * error still means the sensor answered.
+ */
+static void breaker_record(htu21d_dev_t *dev, int ret)
+{
+    if (ret == HTU21D_ERR_OK || ret == HTU21D_ERR_CRC) {
+        dev->failures = 0;
+        dev->backoff_ms = HTU21D_BACKOFF_MIN_MS;
+        return;
+    }
+    if (ret == HTU21D_ERR_INVALID_ARG || dev->breaker_threshold == 0) {
+        return;
+    }
+    if (dev->failures < UINT8_MAX) {
+        dev->failures++;
+    }
+    if (dev->failures >= dev->breaker_threshold) {
+        // failing again right after a successful probe waits longer
+        back_off(dev, dev->failures > dev->breaker_threshold);
+    }
+}
+
+/**
+ * @brief Converts a raw measurement to a checked 14-bit value in `raw_value`.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_CRC with the unchecked value.
+ */
+static int decode_measurement(const uint8_t data[3], uint16_t *raw_value)
+{
+    uint8_t msb = data[0], lsb = data[1], crc = data[2];
+    uint16_t value = ((uint16_t) msb << 8) | (uint16_t) lsb;
+    *raw_value = value & 0xFFFC;
+    if (!is_crc_valid(value, crc)) {
+        HTU21D_LOGE(TAG, "CRC is invalid.");
+        return HTU21D_ERR_CRC;
+    }
+    return HTU21D_ERR_OK;
+}
 
 /**
  * @brief Initializes the HTU21D temperature/humidity sensor and the I2C bus.
@@ -40,64 +273,136 @@ static i2c_port_t _port = 0; /**< The I2C port that the HTU21D sensor is connect
  */
 int htu21d_init(i2c_port_t port, int sda_pin, int scl_pin,  gpio_pullup_t sda_internal_pullup,  gpio_pullup_t scl_internal_pullup)
 {
-    esp_err_t ret;
-    _port = port;
+    int ret = htu21d_bus_init(port, sda_pin, scl_pin, sda_internal_pullup, scl_internal_pullup);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+
+    return htu21d_dev_init(&_dev, port, HTU21D_NO_MUX, 0);
+}
+
+/**
+ * @brief Initializes an I2C bus for one or more HTU21D sensors, without
+ * looking for a sensor.
+ *
+ * I2C bus runs in master mode @ 100,000. Follow with htu21d_dev_init() for
+ * every sensor on the bus.
+ * @return Returns #HTU21D_ERR_OK on success, #HTU21D_ERR_CONFIG if there is an
+ * error configuring the I2C bus or #HTU21D_ERR_INSTALL if the I2C driver fails
+ * to install.
+ */
+int htu21d_bus_init(i2c_port_t port, int sda_pin, int scl_pin,  gpio_pullup_t sda_internal_pullup,  gpio_pullup_t scl_internal_pullup)
+{
+    int ret;
 
     // setup i2c controller
-    i2c_config_t conf = {0};
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = sda_pin;
-    conf.scl_io_num = scl_pin;
-    conf.sda_pullup_en = sda_internal_pullup;
-    conf.scl_pullup_en = scl_internal_pullup;
-    conf.master.clk_speed = 100000;
-    ret = i2c_param_config(port, &conf);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure I2C (port %d, sda_pin %d, scl_pin %d): %s", port, sda_pin, scl_pin, esp_err_to_name(ret));
+    ret = htu21d_port_bus_config(port, sda_pin, scl_pin, sda_internal_pullup, scl_internal_pullup);
+    if (ret != HTU21D_ERR_OK) {
+        HTU21D_LOGE(TAG, "Failed to configure I2C (port %d, sda_pin %d, scl_pin %d)", port, sda_pin, scl_pin);
         return HTU21D_ERR_CONFIG;
     }
 
     // install the driver
-    ret = i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install I2C driver: %s", esp_err_to_name(ret));
+    ret = htu21d_port_bus_install(port);
+    if (ret != HTU21D_ERR_OK) {
+        HTU21D_LOGE(TAG, "Failed to install I2C driver");
         return HTU21D_ERR_INSTALL;
     }
 
+    // whatever mux channel is open on the bus is unknown from here on
+    htu21d_bus_state_t *bus = bus_state(port);
+    if (bus != NULL) {
+        bus->known = false;
+        bus->mux_address = HTU21D_NO_MUX;
+    }
+
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Sets up `dev` for a sensor on an initialized bus and checks that it
+ * answers.
+ *
+ * The device starts in #HTU21D_READ_MODE_FIXED_WAIT, assuming the slowest
+ * (power-on) resolution until it is read or written, with a circuit breaker
+ * after #HTU21D_BREAKER_THRESHOLD failed measurements.
+ * @param dev Device to set up.
+ * @param port I2C port the sensor (or its mux) is on.
+ * @param mux_address I2C address of the TCA9548A-compatible mux the sensor is
+ * behind, or #HTU21D_NO_MUX.
+ * @param mux_channel Mux channel (0-7) the sensor is on.
+ * @return Returns #HTU21D_ERR_OK if the sensor is found,
+ * #HTU21D_ERR_INVALID_ARG for a bad channel and #HTU21D_ERR_NOTFOUND if the
+ * sensor (or its mux) does not answer.
+ */
+int htu21d_dev_init(htu21d_dev_t *dev, i2c_port_t port, uint8_t mux_address, uint8_t mux_channel)
+{
+    if (dev == NULL || mux_channel > 7) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    *dev = (htu21d_dev_t) {
+        .port = port,
+        .mux_address = mux_address,
+        .mux_channel = mux_channel,
+        .read_mode = HTU21D_READ_MODE_FIXED_WAIT,
+        .resolution = 0x00,
+        .pending_command = 0,
+        .user_register = HTU21D_USER_REGISTER_DEFAULT,
+        .temperature_oversampling = 1,
+        .humidity_oversampling = 1,
+        .breaker_threshold = HTU21D_BREAKER_THRESHOLD,
+        .failures = 0,
+        .backoff_ms = HTU21D_BACKOFF_MIN_MS,
+        .retry_us = 0,
+        .pending_done_us = 0,
+    };
+
     // verify if a sensor is present
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return HTU21D_ERR_FAIL;
-    }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(
-                                      cmd, (HTU21D_ADDR << 1) | I2C_MASTER_WRITE, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "HTU21D sensor not found on bus: %s", esp_err_to_name(ret));
+    int ret = select_dev(dev);
+    if (ret == HTU21D_ERR_OK) {
+        ret = htu21d_port_probe(port, HTU21D_ADDR, HTU21D_I2C_TIMEOUT_MS);
+    }
+    if (ret != HTU21D_ERR_OK) {
+        HTU21D_LOGE(TAG, "HTU21D sensor not found on bus");
         return HTU21D_ERR_NOTFOUND;
     }
 
     return HTU21D_ERR_OK;
 }
 
+/**
+ * @brief Returns the device used by the functions that don't take one, set up
+ * by htu21d_init(). Can be used to change its htu21d_dev_t::read_mode.
+ */
+htu21d_dev_t *htu21d_get_default_dev()
+{
+    return &_dev;
+}
+
 /**
  * @brief Read the temperature from the HTU21D sensor.
  * @return Returns the temperature read from the HTU21D sensor in degrees
  * Celsius. Returns `-999` if it fails to read the temperature from the sensor.
  */
 float htu21d_read_temperature()
+{
+    return htu21d_dev_read_temperature(&_dev);
+}
+
+/**
+ * @brief Read the temperature from a HTU21D sensor.
+ * @return Returns the temperature in degrees Celsius, or `-999` if it fails
+ * to read the temperature from the sensor.
+ */
+float htu21d_dev_read_temperature(htu21d_dev_t *dev)
 {
     // get the raw value from the sensor
-    uint16_t raw_temperature = read_value(TRIGGER_TEMP_MEASURE_NOHOLD);
+    uint16_t raw_temperature = htu21d_dev_read_value(dev, TRIGGER_TEMP_MEASURE_NOHOLD);
     if (raw_temperature == 0) {
         return -999;
     }
 
-    // return the real value, formula in datasheet
-    return (raw_temperature * 175.72 / 65536.0) - 46.85;
+    return htu21d_raw_to_temperature(raw_temperature);
 }
 
 /**
@@ -128,28 +433,374 @@ float htu21d_read_temperature()
  * sensor. Returns `-999` if it fails to read the humidity from the sensor.
  */
 float htu21d_read_humidity()
+{
+    return htu21d_dev_read_humidity(&_dev);
+}
+
+/**
+ * @brief Read the relative humidity from a HTU21D sensor.
+ * @return Returns the relative humidity percentage %, or `-999` if it fails
+ * to read the humidity from the sensor.
+ */
+float htu21d_dev_read_humidity(htu21d_dev_t *dev)
 {
     // get the raw value from the sensor
-    uint16_t raw_humidity = read_value(TRIGGER_HUMD_MEASURE_NOHOLD);
+    uint16_t raw_humidity = htu21d_dev_read_value(dev, TRIGGER_HUMD_MEASURE_NOHOLD);
     if (raw_humidity == 0) {
         return -999;
     }
 
-    // return the real value, formula in datasheet
-    return (raw_humidity * 125.0 / 65536.0) - 6.0;
+    return htu21d_raw_to_humidity(raw_humidity);
+}
+
+/**
+ * @brief Converts a raw temperature code to degrees Celsius (formula in
+ * datasheet).
+ */
+float htu21d_raw_to_temperature(uint16_t raw_temperature)
+{
+    return (raw_temperature * 175.72F / 65536.0F) - 46.85F;
+}
+
+/**
+ * @brief Converts a raw humidity code to relative humidity % (formula in
+ * datasheet).
+ */
+float htu21d_raw_to_humidity(uint16_t raw_humidity)
+{
+    return (raw_humidity * 125.0F / 65536.0F) - 6.0F;
+}
+
+/**
+ * @brief Returns the datasheet's maximum conversion time of a measurement.
+ * @param resolution Resolution bits of the user register.
+ * @param command One of the `TRIGGER_*` commands.
+ */
+uint32_t htu21d_conversion_time_ms(uint8_t resolution, uint8_t command)
+{
+    return conversion_time(resolution, command)->max_ms;
+}
+
+int htu21d_read_sample(htu21d_sample_t *sample)
+{
+    return htu21d_dev_read_sample(&_dev, sample);
+}
+
+/**
+ * @brief Measures one channel of a sample, repeating it after a CRC error.
+ *
+ * Clears #HTU21D_SAMPLE_CRC_OK in `flags` if the retries fail too, the value
+ * is kept then.
+ */
+static int read_checked(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value, uint8_t *flags)
+{
+    int ret = read_averaged(dev, command, raw_value);
+    for (int retry = 0; ret == HTU21D_ERR_CRC && retry < HTU21D_SAMPLE_RETRIES; retry++) {
+        *flags |= HTU21D_SAMPLE_RETRIED;
+        ret = read_averaged(dev, command, raw_value);
+    }
+    if (ret == HTU21D_ERR_CRC) {
+        *flags &= ~HTU21D_SAMPLE_CRC_OK;
+        return HTU21D_ERR_OK;
+    }
+    return ret;
+}
+
+/**
+ * @brief Measures temperature and humidity into a sample without converting
+ * them, see #htu21d_sample_t.
+ *
+ * The quality flags are set from the CRC checks, the raw codes and the user
+ * register as last read or written; call htu21d_dev_read_user_register() now
+ * and then to refresh the heater and low battery flags.
+ * @return Returns #HTU21D_ERR_OK, or the error of the measurement that failed
+ * (the sample is left unchanged then).
+ */
+int htu21d_dev_read_sample(htu21d_dev_t *dev, htu21d_sample_t *sample)
+{
+    if (dev == NULL || sample == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    uint64_t timestamp_us = htu21d_port_time_us();
+    uint8_t flags = HTU21D_SAMPLE_CRC_OK;
+    uint16_t raw_temperature, raw_humidity;
+
+    int ret = read_checked(dev, TRIGGER_TEMP_MEASURE_NOHOLD, &raw_temperature, &flags);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    ret = read_checked(dev, TRIGGER_HUMD_MEASURE_NOHOLD, &raw_humidity, &flags);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+
+    if (raw_temperature < HTU21D_RAW_TEMPERATURE_MIN || raw_temperature > HTU21D_RAW_TEMPERATURE_MAX ||
+            raw_humidity < HTU21D_RAW_HUMIDITY_MIN || raw_humidity > HTU21D_RAW_HUMIDITY_MAX) {
+        flags |= HTU21D_SAMPLE_OUT_OF_RANGE;
+    }
+    if (dev->user_register & HTU21D_USER_REGISTER_HEATER) {
+        flags |= HTU21D_SAMPLE_HEATER_ON;
+    }
+    if (dev->user_register & HTU21D_USER_REGISTER_BATTERY) {
+        flags |= HTU21D_SAMPLE_LOW_BATTERY;
+    }
+    flags |= (((dev->resolution >> 6) & 0x02) | (dev->resolution & 0x01)) << HTU21D_SAMPLE_RESOLUTION_SHIFT;
+
+    htu21d_sample_from_raw(sample, raw_temperature, raw_humidity, dev->resolution, flags, timestamp_us);
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Fills a sample with stored raw codes and flags, nothing converted
+ * yet.
+ */
+void htu21d_sample_from_raw(htu21d_sample_t *sample, uint16_t raw_temperature, uint16_t raw_humidity,
+                            uint8_t resolution, uint8_t flags, uint64_t timestamp_us)
+{
+    *sample = (htu21d_sample_t) {
+        .raw_temperature = raw_temperature,
+        .raw_humidity = raw_humidity,
+        .resolution = resolution,
+        .flags = flags,
+        .converted = 0,
+        .timestamp_us = timestamp_us,
+    };
+}
+
+/**
+ * @brief Temperature of a sample in degC, converted on the first call.
+ */
+float htu21d_sample_temperature(htu21d_sample_t *sample)
+{
+    if (!(sample->converted & HTU21D_CONVERTED_TEMPERATURE)) {
+        sample->temperature = htu21d_raw_to_temperature(sample->raw_temperature);
+        sample->converted |= HTU21D_CONVERTED_TEMPERATURE;
+    }
+    return sample->temperature;
+}
+
+/**
+ * @brief Relative humidity of a sample in %, converted on the first call.
+ */
+float htu21d_sample_humidity(htu21d_sample_t *sample)
+{
+    if (!(sample->converted & HTU21D_CONVERTED_HUMIDITY)) {
+        sample->humidity = htu21d_raw_to_humidity(sample->raw_humidity);
+        sample->converted |= HTU21D_CONVERTED_HUMIDITY;
+    }
+    return sample->humidity;
+}
+
+#if CONFIG_HTU21D_DERIVED_MATH
+/**
+ * @brief Temperature compensated relative humidity of a sample in %, computed
+ * on the first call.
+ */
+float htu21d_sample_compensated_humidity(htu21d_sample_t *sample)
+{
+    if (!(sample->converted & HTU21D_CONVERTED_COMPENSATED)) {
+        sample->compensated_humidity = htu21_compute_compensated_humidity(htu21d_sample_temperature(sample),
+                                       htu21d_sample_humidity(sample));
+        sample->converted |= HTU21D_CONVERTED_COMPENSATED;
+    }
+    return sample->compensated_humidity;
+}
+
+/**
+ * @brief Dew point of a sample in degC, from the compensated humidity,
+ * computed on the first call.
+ */
+float htu21d_sample_dew_point(htu21d_sample_t *sample)
+{
+    if (!(sample->converted & HTU21D_CONVERTED_DEW_POINT)) {
+        sample->dew_point = htu21d_compute_dew_point(htu21d_sample_temperature(sample),
+                            htu21d_sample_compensated_humidity(sample));
+        sample->converted |= HTU21D_CONVERTED_DEW_POINT;
+    }
+    return sample->dew_point;
+}
+#endif  // CONFIG_HTU21D_DERIVED_MATH
+
+/**
+ * @brief Picks the resolution and oversampling of a temperature + humidity
+ * reading for a noise target or a latency/energy budget.
+ *
+ * Every resolution with 1, 2, 4, 8 or 16 averaged conversions per channel is
+ * considered, assuming averaging `n` conversions divides the noise by
+ * `sqrt(n)`. With a noise target the cheapest configuration meeting it (and
+ * the budget, if any) wins. With only a budget the least noisy configuration
+ * within it wins.
+ *
+ * Latency and energy are the datasheet's maximum conversion times, at 3.0 V
+ * and the typical 450 uA while converting; I2C traffic is not included.
+ * @param goal Noise targets and budgets, zero fields are ignored.
+ * @param noise Single conversion noise of the four resolutions, e.g. measured
+ * with examples/noise_sweep_htu21d, or `NULL` for datasheet figures.
+ * @param[out] plan The chosen configuration, see htu21d_dev_apply_plan().
+ * @return Returns #HTU21D_ERR_OK with a plan, #HTU21D_ERR_NOTFOUND if no
+ * configuration meets the goal or #HTU21D_ERR_INVALID_ARG if the goal sets
+ * nothing.
+ */
+int htu21d_plan(const htu21d_goal_t *goal, const htu21d_noise_t noise[HTU21D_RESOLUTIONS], htu21d_plan_t *plan)
+{
+    if (goal == NULL || plan == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    bool noise_goal = goal->temperature_noise > 0 || goal->humidity_noise > 0;
+    if (!noise_goal && goal->latency_ms == 0 && goal->energy_uj <= 0) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    if (noise == NULL) {
+        noise = _datasheet_noise;
+    }
+
+    // noise is compared relative to the quietest single conversion
+    float unit_t = noise[0].temperature, unit_rh = noise[0].humidity;
+    for (int r = 1; r < HTU21D_RESOLUTIONS; r++) {
+        unit_t = noise[r].temperature < unit_t ? noise[r].temperature : unit_t;
+        unit_rh = noise[r].humidity < unit_rh ? noise[r].humidity : unit_rh;
+    }
+
+    bool found = false;
+    float best_cost = 0, best_noise = 0;
+    for (int r = 0; r < HTU21D_RESOLUTIONS; r++) {
+        uint8_t resolution = noise[r].resolution & HTU21D_RESOLUTION_MASK;
+        uint32_t t_ms = conversion_time(resolution, TRIGGER_TEMP_MEASURE_NOHOLD)->max_ms;
+        uint32_t rh_ms = conversion_time(resolution, TRIGGER_HUMD_MEASURE_NOHOLD)->max_ms;
+
+        float noise_t = noise[r].temperature;
+        for (uint8_t n_t = 1; n_t <= HTU21D_MAX_OVERSAMPLING; n_t *= 2, noise_t *= HTU21D_SQRT1_2) {
+            if (goal->temperature_noise > 0 && noise_t > goal->temperature_noise) {
+                continue;
+            }
+            float noise_rh = noise[r].humidity;
+            for (uint8_t n_rh = 1; n_rh <= HTU21D_MAX_OVERSAMPLING; n_rh *= 2, noise_rh *= HTU21D_SQRT1_2) {
+                if (goal->humidity_noise > 0 && noise_rh > goal->humidity_noise) {
+                    continue;
+                }
+                uint32_t latency_ms = n_t * t_ms + n_rh * rh_ms;
+                float energy_uj = latency_ms * HTU21D_MEASURING_UJ_PER_MS;
+                if ((goal->latency_ms > 0 && latency_ms > goal->latency_ms) ||
+                        (goal->energy_uj > 0 && energy_uj > goal->energy_uj)) {
+                    continue;
+                }
+
+                float relative_noise = noise_t / unit_t + noise_rh / unit_rh;
+                float cost = noise_goal ? energy_uj : relative_noise;
+                float tie = noise_goal ? relative_noise : energy_uj;
+                if (found && (cost > best_cost || (cost == best_cost && tie >= best_noise))) {
+                    continue;
+                }
+                found = true;
+                best_cost = cost;
+                best_noise = tie;
+                *plan = (htu21d_plan_t) {
+                    .resolution = resolution,
+                    .temperature_oversampling = n_t,
+                    .humidity_oversampling = n_rh,
+                    .temperature_noise = noise_t,
+                    .humidity_noise = noise_rh,
+                    .latency_ms = latency_ms,
+                    .energy_uj = energy_uj,
+                };
+            }
+        }
+    }
+    return found ? HTU21D_ERR_OK : HTU21D_ERR_NOTFOUND;
+}
+
+/**
+ * @brief Single conversion noise at one resolution.
+ * @param resolution Resolution bits, e.g. from htu21d_get_resolution() or
+ * HTU21D_SAMPLE_RESOLUTION().
+ * @param noise Figures of the four resolutions as for htu21d_plan(), or `NULL`
+ * for datasheet figures.
+ * @param[out] single Noise at `resolution`.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_NOTFOUND if `noise` has no
+ * entry for `resolution`.
+ */
+int htu21d_resolution_noise(uint8_t resolution, const htu21d_noise_t noise[HTU21D_RESOLUTIONS],
+                            htu21d_noise_t *single)
+{
+    if (noise == NULL) {
+        noise = _datasheet_noise;
+    }
+    resolution &= HTU21D_RESOLUTION_MASK;
+    for (int r = 0; r < HTU21D_RESOLUTIONS; r++) {
+        if ((noise[r].resolution & HTU21D_RESOLUTION_MASK) == resolution) {
+            *single = noise[r];
+            return HTU21D_ERR_OK;
+        }
+    }
+    return HTU21D_ERR_NOTFOUND;
+}
+
+/**
+ * @brief Configures a sensor as planned by htu21d_plan(): writes the
+ * resolution to the user register and sets the device's oversampling.
+ * @return Returns #HTU21D_ERR_OK on success, or the error of writing the user
+ * register (the oversampling is left unchanged then).
+ */
+int htu21d_dev_apply_plan(htu21d_dev_t *dev, const htu21d_plan_t *plan)
+{
+    if (dev == NULL || plan == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    int ret = htu21d_dev_set_resolution(dev, plan->resolution);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    dev->temperature_oversampling = plan->temperature_oversampling;
+    dev->humidity_oversampling = plan->humidity_oversampling;
+    return HTU21D_ERR_OK;
+}
+
+#if CONFIG_HTU21D_DERIVED_MATH
+/**
+ * @brief Saturation vapor pressure over water in mmHg (the datasheet's
+ * Antoine equation), shared by the dew point and the psychrometric kernels.
+ */
+static inline float saturation_pressure(float temperature)
+{
+    return exp2f(HTU21_CONSTANT_A * HTU21D_LOG2_10 -
+                 HTU21_CONSTANT_B * HTU21D_LOG2_10 / (temperature + HTU21_CONSTANT_C));
+}
+
+/**
+ * @brief Specific enthalpy of moist air in kJ/kg of dry air, see
+ * htu21d_compute_enthalpy().
+ */
+static inline float enthalpy(float temperature, float humidity_ratio)
+{
+    return 1.006F * temperature + humidity_ratio * (2501.0F + 1.86F * temperature);
+}
+
+/**
+ * @brief Humidity ratio and enthalpy from one saturation pressure evaluation.
+ */
+static inline htu21d_moist_air_t moist_air(float temperature, float relative_humidity, float pressure_kpa)
+{
+    float vapor_kpa = relative_humidity * 0.01F * HTU21D_KPA_PER_MMHG * saturation_pressure(temperature);
+    float ratio = HTU21D_WATER_AIR_MASS_RATIO * vapor_kpa / (pressure_kpa - vapor_kpa);
+
+    return (htu21d_moist_air_t) {
+        .humidity_ratio = ratio,
+        .enthalpy = enthalpy(temperature, ratio),
+    };
 }
 
 /**
  * @brief Calculates the Partial Pressure at ambient temperature, by using the
  * ambient temperature read from the HTU21D sensor.
  *
- * This function is really only used to calculate the dew point.
+ * This is the saturation vapor pressure behind the dew point, humidity ratio
+ * and enthalpy.
  * @param[in] temperature Actual ambient temperature measured from sensor (degC).
  * @return Returns the current Partial Pressure in mmHg at ambient temperature.
  */
 float htu21d_compute_partial_pressure(float temperature)
 {
-    return pow(10, HTU21_CONSTANT_A - HTU21_CONSTANT_B / (temperature + HTU21_CONSTANT_C));
+    return saturation_pressure(temperature);
 }
 
 /**
@@ -178,198 +829,421 @@ float htu21d_compute_dew_point(float temperature, float relative_humidity)
     float partial_pressure = htu21d_compute_partial_pressure(temperature);
 
     return - HTU21_CONSTANT_B /
-           (log10(relative_humidity * partial_pressure / 100.0F) - HTU21_CONSTANT_A)
+           (log10f(relative_humidity * partial_pressure / 100.0F) - HTU21_CONSTANT_A)
            - HTU21_CONSTANT_C;
 }
 
+/**
+ * @brief Calculates the humidity ratio (mixing ratio) of moist air.
+ * @param[in] temperature Ambient temperature (degC).
+ * @param[in] relative_humidity Relative humidity (%RH).
+ * @param[in] pressure_kpa Barometric pressure (kPa, 101.325 at sea level).
+ * @return Returns the mass of water vapor per mass of dry air (kg/kg).
+ */
+float htu21d_compute_humidity_ratio(float temperature, float relative_humidity, float pressure_kpa)
+{
+    return moist_air(temperature, relative_humidity, pressure_kpa).humidity_ratio;
+}
+
+/**
+ * @brief Calculates the specific enthalpy of moist air, the figure economizers
+ * compare between outdoor and return air.
+ * @param[in] temperature Ambient temperature (degC).
+ * @param[in] humidity_ratio From htu21d_compute_humidity_ratio() (kg/kg).
+ * @return Returns the enthalpy per mass of dry air (kJ/kg), 0 for dry air at
+ * 0 degC.
+ */
+float htu21d_compute_enthalpy(float temperature, float humidity_ratio)
+{
+    return enthalpy(temperature, humidity_ratio);
+}
+
+/**
+ * @brief Calculates humidity ratio and enthalpy together, evaluating the
+ * saturation pressure once.
+ * @param[in] temperature Ambient temperature (degC).
+ * @param[in] relative_humidity Relative humidity (%RH).
+ * @param[in] pressure_kpa Barometric pressure (kPa).
+ * @param[out] air Humidity ratio and enthalpy.
+ */
+void htu21d_compute_moist_air(float temperature, float relative_humidity, float pressure_kpa,
+                              htu21d_moist_air_t *air)
+{
+    *air = moist_air(temperature, relative_humidity, pressure_kpa);
+}
+
+/**
+ * @brief htu21d_compute_moist_air() over arrays of readings at one barometric
+ * pressure, e.g. every sensor of an air handler.
+ *
+ * A straight loop with one exp2f() and one division per reading and no
+ * calls to the other helpers, so the compiler keeps everything in registers.
+ * @param[in] temperature `count` temperatures (degC).
+ * @param[in] relative_humidity `count` relative humidities (%RH).
+ * @param[in] pressure_kpa Barometric pressure (kPa).
+ * @param[in] count Number of readings.
+ * @param[out] air `count` results.
+ */
+void htu21d_compute_moist_air_batch(const float *temperature, const float *relative_humidity, float pressure_kpa,
+                                    size_t count, htu21d_moist_air_t *air)
+{
+    for (size_t i = 0; i < count; i++) {
+        air[i] = moist_air(temperature[i], relative_humidity[i], pressure_kpa);
+    }
+}
+#endif  // CONFIG_HTU21D_DERIVED_MATH
+
 uint8_t htu21d_get_resolution()
 {
-    uint8_t reg_value = htu21d_read_user_register();
-    return reg_value & 0b10000001;
+    return htu21d_dev_get_resolution(&_dev);
+}
+
+uint8_t htu21d_dev_get_resolution(htu21d_dev_t *dev)
+{
+    uint8_t reg_value = htu21d_dev_read_user_register(dev);
+    return reg_value & HTU21D_RESOLUTION_MASK;
 }
 
 int htu21d_set_resolution(uint8_t resolution)
 {
+    return htu21d_dev_set_resolution(&_dev, resolution);
+}
 
-    // get the actual resolution
-    uint8_t reg_value = htu21d_read_user_register();
-    reg_value &= 0b10000001;
+int htu21d_dev_set_resolution(htu21d_dev_t *dev, uint8_t resolution)
+{
+    // get the actual register, keeping the heater and reserved bits
+    uint8_t reg_value = htu21d_dev_read_user_register(dev);
+    reg_value &= ~HTU21D_RESOLUTION_MASK;
 
     // update the register value with the new resolution
-    resolution &= 0b10000001;
+    resolution &= HTU21D_RESOLUTION_MASK;
     reg_value |= resolution;
 
-    return htu21d_write_user_register(reg_value);
+    return htu21d_dev_write_user_register(dev, reg_value);
 }
 
 int htu21d_soft_reset()
 {
-    esp_err_t ret;
-
-    // send the command
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return HTU21D_ERR_FAIL;
-    }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(
-                                      cmd, (HTU21D_ADDR << 1) | I2C_MASTER_WRITE, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, SOFT_RESET, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS);
-    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
-    i2c_cmd_link_delete(cmd);
-
-    switch (ret) {
-
-    case ESP_ERR_INVALID_ARG:
-        return HTU21D_ERR_INVALID_ARG;
-
-    case ESP_FAIL:
-        return HTU21D_ERR_FAIL;
+    return htu21d_dev_soft_reset(&_dev);
+}
 
-    case ESP_ERR_INVALID_STATE:
-        return HTU21D_ERR_INVALID_STATE;
+int htu21d_dev_soft_reset(htu21d_dev_t *dev)
+{
+    uint8_t command = SOFT_RESET;
 
-    case ESP_ERR_TIMEOUT:
-        return HTU21D_ERR_TIMEOUT;
+    int ret = select_dev(dev);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
     }
-    return HTU21D_ERR_OK;
+    ret = htu21d_port_write(dev->port, HTU21D_ADDR, &command, 1, HTU21D_I2C_TIMEOUT_MS);
+    if (ret == HTU21D_ERR_OK) {
+        // back to the power-on resolution
+        dev->resolution = 0x00;
+        dev->user_register = HTU21D_USER_REGISTER_DEFAULT;
+        dev->pending_command = 0;
+    }
+    return ret;
 }
 
 uint8_t htu21d_read_user_register()
 {
-    esp_err_t ret;
+    return htu21d_dev_read_user_register(&_dev);
+}
 
-    // send the command
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return 0;
-    }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(
-                                      cmd, (HTU21D_ADDR << 1) | I2C_MASTER_WRITE, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, READ_USER_REG, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS);
-    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
-    i2c_cmd_link_delete(cmd);
-    if (ret != ESP_OK) {
+uint8_t htu21d_dev_read_user_register(htu21d_dev_t *dev)
+{
+    if (htu21d_dev_load_user_register(dev) != HTU21D_ERR_OK) {
         return 0;
     }
+    return dev->user_register;
+}
 
-    // receive the answer
+/**
+ * @brief Reads the user register into htu21d_dev_t::user_register and
+ * htu21d_dev_t::resolution.
+ *
+ * Unlike htu21d_dev_read_user_register(), a failed read can't be mistaken for
+ * a register value.
+ * @return Returns #HTU21D_ERR_OK, or the bus error (the cached values are
+ * left unchanged then).
+ */
+int htu21d_dev_load_user_register(htu21d_dev_t *dev)
+{
+    uint8_t command = READ_USER_REG;
     uint8_t reg_value;
-    cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return 0;
+
+    // send the command and receive the answer after a repeated start
+    int ret = select_dev(dev);
+    if (ret == HTU21D_ERR_OK) {
+        ret = htu21d_port_write_read(dev->port, HTU21D_ADDR, &command, 1, &reg_value, 1, HTU21D_I2C_TIMEOUT_MS);
     }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(
-                                      cmd, (HTU21D_ADDR << 1) | I2C_MASTER_READ, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_read_byte(cmd, &reg_value, 0x01));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS);
-    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
-    i2c_cmd_link_delete(cmd);
-    if (ret != ESP_OK) {
-        return 0;
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
     }
 
-    return reg_value;
+    dev->resolution = reg_value & HTU21D_RESOLUTION_MASK;
+    dev->user_register = reg_value;
+    return HTU21D_ERR_OK;
 }
 
 int htu21d_write_user_register(uint8_t value)
 {
-    esp_err_t ret;
+    return htu21d_dev_write_user_register(&_dev, value);
+}
+
+int htu21d_dev_write_user_register(htu21d_dev_t *dev, uint8_t value)
+{
+    uint8_t data[2] = {WRITE_USER_REG, value};
 
-    // send the command
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return HTU21D_ERR_FAIL;
-    }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(
-        i2c_master_write_byte(cmd, (HTU21D_ADDR << 1) | I2C_MASTER_WRITE, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, WRITE_USER_REG, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, value, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS);
-    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
-    i2c_cmd_link_delete(cmd);
-
-    switch (ret) {
-
-    case ESP_ERR_INVALID_ARG:
+    int ret = select_dev(dev);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    ret = htu21d_port_write(dev->port, HTU21D_ADDR, data, sizeof(data), HTU21D_I2C_TIMEOUT_MS);
+    if (ret == HTU21D_ERR_OK) {
+        dev->resolution = value & HTU21D_RESOLUTION_MASK;
+        dev->user_register = value;
+    }
+    return ret;
+}
+
+uint16_t read_value(uint8_t command)
+{
+    return htu21d_dev_read_value(&_dev, command);
+}
+
+/**
+ * @brief Sends a no hold master measurement command, see
+ * htu21d_dev_start_measurement().
+ */
+static int start(htu21d_dev_t *dev, uint8_t command)
+{
+    if (command != TRIGGER_TEMP_MEASURE_NOHOLD && command != TRIGGER_HUMD_MEASURE_NOHOLD) {
         return HTU21D_ERR_INVALID_ARG;
+    }
+
+    int ret = select_dev(dev);
+    if (ret == HTU21D_ERR_OK) {
+        ret = htu21d_port_write(dev->port, HTU21D_ADDR, &command, 1, HTU21D_I2C_TIMEOUT_MS);
+    }
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    dev->pending_command = command;
+    dev->pending_done_us = htu21d_port_time_us() + conversion_time(dev->resolution, command)->max_ms * 1000ULL;
+    return HTU21D_ERR_OK;
+}
 
-    case ESP_FAIL:
-        return HTU21D_ERR_FAIL;
+/**
+ * @brief Reads the result of start(), see htu21d_dev_fetch_measurement().
+ */
+static int fetch(htu21d_dev_t *dev, uint16_t *raw_value)
+{
+    uint8_t data[3];
 
-    case ESP_ERR_INVALID_STATE:
+    if (dev->pending_command == 0) {
         return HTU21D_ERR_INVALID_STATE;
+    }
 
-    case ESP_ERR_TIMEOUT:
-        return HTU21D_ERR_TIMEOUT;
+    // receive the answer
+    int ret = select_dev(dev);
+    if (ret == HTU21D_ERR_OK) {
+        ret = htu21d_port_read(dev->port, HTU21D_ADDR, data, sizeof(data), HTU21D_I2C_TIMEOUT_MS);
     }
-    return HTU21D_ERR_OK;
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    dev->pending_command = 0;
+
+    return decode_measurement(data, raw_value);
 }
 
-uint16_t read_value(uint8_t command)
+/**
+ * @brief Runs a single conversion, see htu21d_dev_read_value().
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_CRC with the unchecked value, or
+ * the error that stopped the measurement.
+ */
+static int convert(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value)
 {
-    esp_err_t ret;
+    int ret;
+
+    if (dev->read_mode == HTU21D_READ_MODE_HOLD) {
+        uint8_t data[3];
+
+        // the sensor holds SCL low until the conversion is done
+        command = (command == TRIGGER_HUMD_MEASURE_NOHOLD) ? TRIGGER_HUMD_MEASURE_HOLD : TRIGGER_TEMP_MEASURE_HOLD;
+        ret = select_dev(dev);
+        if (ret == HTU21D_ERR_OK) {
+            ret = htu21d_port_write_read(dev->port, HTU21D_ADDR, &command, 1, data, sizeof(data), HTU21D_I2C_TIMEOUT_MS);
+        }
+        if (ret != HTU21D_ERR_OK) {
+            return ret;
+        }
+        return decode_measurement(data, raw_value);
+    }
 
     // send the command
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return 0;
+    ret = start(dev, command);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
     }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(
-        i2c_master_write_byte(cmd, (HTU21D_ADDR << 1) | I2C_MASTER_WRITE, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, command, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS);
-    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
-    i2c_cmd_link_delete(cmd);
-    if (ret != ESP_OK) {
-        return 0;
+
+    const htu21d_conversion_time_t *time = conversion_time(dev->resolution, command);
+    if (dev->read_mode == HTU21D_READ_MODE_POLLING) {
+        // wait the typical time, then ask until the sensor ACKs its address
+        uint32_t waited_ms = time->typical_ms;
+        htu21d_port_delay_ms(time->typical_ms);
+        ret = fetch(dev, raw_value);
+        while (ret == HTU21D_ERR_FAIL && waited_ms < time->max_ms) {
+            htu21d_port_delay_ms(HTU21D_POLL_INTERVAL_MS);
+            waited_ms += HTU21D_POLL_INTERVAL_MS;
+            ret = fetch(dev, raw_value);
+        }
+    } else {
+        // wait for the sensor
+        htu21d_port_delay_ms(time->max_ms);
+        ret = fetch(dev, raw_value);
+    }
+    if (ret != HTU21D_ERR_OK && ret != HTU21D_ERR_CRC) {
+        dev->pending_command = 0;
     }
+    return ret;
+}
 
-    // wait for the sensor (50ms)
-    vTaskDelay(50 / portTICK_PERIOD_MS);
+/**
+ * @brief Runs a single conversion behind the circuit breaker.
+ */
+static int measure(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value)
+{
+    int ret = breaker_check(dev);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    ret = convert(dev, command, raw_value);
+    breaker_record(dev, ret);
+    return ret;
+}
 
-    // receive the answer
-    uint8_t msb, lsb, crc;
-    cmd = i2c_cmd_link_create();
-    if (cmd == NULL) {
-        ESP_LOGE(TAG, "Not enough dynamic memory");
-        return 0;
+/**
+ * @brief Averages htu21d_dev_t::temperature_oversampling or
+ * htu21d_dev_t::humidity_oversampling conversions.
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_CRC if any conversion failed its
+ * CRC check (it is still part of the average), or the error that stopped the
+ * measurement.
+ */
+static int read_averaged(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value)
+{
+    uint8_t count = is_humidity(command) ? dev->humidity_oversampling : dev->temperature_oversampling;
+    if (count <= 1) {
+        return measure(dev, command, raw_value);
+    }
+
+    uint32_t sum = 0;
+    int status = HTU21D_ERR_OK;
+    for (int i = 0; i < count; i++) {
+        uint16_t value;
+        int ret = measure(dev, command, &value);
+        if (ret == HTU21D_ERR_CRC) {
+            status = HTU21D_ERR_CRC;
+        } else if (ret != HTU21D_ERR_OK) {
+            return ret;
+        }
+        sum += value;
     }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(
-        i2c_master_write_byte(cmd, (HTU21D_ADDR << 1) | I2C_MASTER_READ, true));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_read_byte(cmd, &msb, 0x00));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_read_byte(cmd, &lsb, 0x00));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_read_byte(cmd, &crc, 0x01));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
-    ret = i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS);
-    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
-    i2c_cmd_link_delete(cmd);
-    if (ret != ESP_OK) {
+    *raw_value = (uint16_t)((sum + count / 2) / count);
+    return status;
+}
+
+/**
+ * @brief Measures with `command` in the device's htu21d_dev_t::read_mode,
+ * averaging htu21d_dev_t::temperature_oversampling or
+ * htu21d_dev_t::humidity_oversampling conversions.
+ *
+ * A CRC error is only logged; htu21d_dev_read_sample() reports it in the
+ * sample's flags.
+ * @param command #TRIGGER_TEMP_MEASURE_NOHOLD or #TRIGGER_HUMD_MEASURE_NOHOLD,
+ * the hold variant is used in #HTU21D_READ_MODE_HOLD.
+ * @return Returns the raw measurement with the status bits cleared (an
+ * average keeps its extra resolution in them), or `0` on failure.
+ */
+uint16_t htu21d_dev_read_value(htu21d_dev_t *dev, uint8_t command)
+{
+    uint16_t raw_value;
+
+    int ret = read_averaged(dev, command, &raw_value);
+    if (ret != HTU21D_ERR_OK && ret != HTU21D_ERR_CRC) {
         return 0;
     }
+    return raw_value;
+}
+
+/**
+ * @brief Runs a single conversion in the device's htu21d_dev_t::read_mode,
+ * without oversampling, behind the circuit breaker.
+ * @param command #TRIGGER_TEMP_MEASURE_NOHOLD or #TRIGGER_HUMD_MEASURE_NOHOLD.
+ * @param[out] raw_value Raw measurement with the status bits cleared.
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_CRC with the unchecked value, or
+ * the error that stopped the measurement.
+ */
+int htu21d_dev_measure(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value)
+{
+    if (dev == NULL || raw_value == NULL ||
+            (command != TRIGGER_TEMP_MEASURE_NOHOLD && command != TRIGGER_HUMD_MEASURE_NOHOLD)) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    return measure(dev, command, raw_value);
+}
 
-    uint16_t raw_value = ((uint16_t) msb << 8) | (uint16_t) lsb;
-    if (!is_crc_valid(raw_value, crc)) {
-        ESP_LOGE(TAG, "CRC is invalid.");
+/**
+ * @brief Starts a no hold master measurement and returns right away.
+ *
+ * Lets many sensors convert at the same time: start them all, wait
+ * htu21d_conversion_time_ms(), then collect the results with
+ * htu21d_dev_fetch_measurement().
+ * @param command #TRIGGER_TEMP_MEASURE_NOHOLD or #TRIGGER_HUMD_MEASURE_NOHOLD.
+ * A sent command doesn't count as a success for the circuit breaker yet, the
+ * fetch of its result does.
+ * @return Returns #HTU21D_ERR_OK once the command is sent, or
+ * #HTU21D_ERR_UNAVAILABLE without touching the bus while the sensor's circuit
+ * breaker is open.
+ */
+int htu21d_dev_start_measurement(htu21d_dev_t *dev, uint8_t command)
+{
+    int ret = breaker_check(dev);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    ret = start(dev, command);
+    if (ret != HTU21D_ERR_OK) {
+        breaker_record(dev, ret);
+    }
+    return ret;
+}
+
+/**
+ * @brief Reads the result of htu21d_dev_start_measurement().
+ *
+ * The outcome counts for the sensor's circuit breaker, except a NACK within
+ * the conversion time. Any other failure ends the measurement.
+ * @param[out] raw_value Raw measurement with the status bits cleared.
+ * @return Returns #HTU21D_ERR_OK with the result, #HTU21D_ERR_CRC with the
+ * result if it failed its CRC check, #HTU21D_ERR_FAIL if the sensor is still
+ * converting (it NACKs its address; past the datasheet's maximum conversion
+ * time that is a failure) and #HTU21D_ERR_INVALID_STATE if no measurement was
+ * started.
+ */
+int htu21d_dev_fetch_measurement(htu21d_dev_t *dev, uint16_t *raw_value)
+{
+    int ret = fetch(dev, raw_value);
+    if (ret == HTU21D_ERR_INVALID_STATE ||
+            (ret == HTU21D_ERR_FAIL && htu21d_port_time_us() < dev->pending_done_us)) {
+        return ret;
+    }
+    if (ret != HTU21D_ERR_OK && ret != HTU21D_ERR_CRC) {
+        dev->pending_command = 0;
     }
-    return raw_value & 0xFFFC;
+    breaker_record(dev, ret);
+    return ret;
 }
 
 // verify the CRC, algorithm in the datasheet (see comments below)
@@ -409,6 +1283,7 @@ float celsius_to_fahrenheit(float celsius_degrees)
     return (celsius_degrees * 9.0F / 5.0F) + 32.0F;
 }
 
+#if CONFIG_HTU21D_DERIVED_MATH
 /**
  * @brief Computes the temperature compensated humidity.
  *
@@ -427,3 +1302,4 @@ float htu21_compute_compensated_humidity(float temperature,
     return (relative_humidity +
             (25.0F - temperature) * HTU21_TEMPERATURE_COEFFICIENT);
 }
+#endif  // CONFIG_HTU21D_DERIVED_MATH
@@ -15,9 +15,36 @@
 #ifndef __ESP_HTU21D_H__
 #define __ESP_HTU21D_H__
 
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
 #include "esp_err.h"
 #include "driver/i2c.h"
 #include "freertos/task.h"
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Linux (i2c-dev) build: the port number selects the `/dev/i2c-<port>`
+// adapter, pins and pull-ups are fixed by the board and ignored.
+typedef int i2c_port_t;
+typedef enum {
+    GPIO_PULLUP_DISABLE = 0,
+    GPIO_PULLUP_ENABLE = 1,
+} gpio_pullup_t;
+
+// Feature options, see Kconfig. Everything is enabled unless the build
+// defines the option to 0.
+#ifndef CONFIG_HTU21D_DERIVED_MATH
+#define CONFIG_HTU21D_DERIVED_MATH 1
+#endif
+#ifndef CONFIG_HTU21D_LOGGING
+#define CONFIG_HTU21D_LOGGING 1
+#endif
+#ifndef CONFIG_HTU21D_SPECTRUM
+#define CONFIG_HTU21D_SPECTRUM 1
+#endif
+#endif
 
 #define HTU21D_ADDR     0x40 /**< I2C address of the HTU21D sensor. */
 
@@ -39,6 +66,136 @@
 #define HTU21D_ERR_FAIL             0x05
 #define HTU21D_ERR_INVALID_STATE    0x06
 #define HTU21D_ERR_TIMEOUT          0x07
+#define HTU21D_ERR_CRC              0x08
+#define HTU21D_ERR_UNAVAILABLE      0x09 /**< Sensor left alone after repeated failures, see htu21d_dev_t::breaker_threshold. */
+
+#define HTU21D_NO_MUX       0x00 /**< htu21d_dev_t::mux_address of a sensor wired straight to the bus. */
+#define HTU21D_MAX_BUSES    4    /**< I2C ports whose mux selection can be tracked at the same time. */
+#define HTU21D_RESOLUTIONS  4    /**< Selectable resolutions (user register bits 7 and 0). */
+#define HTU21D_MAX_OVERSAMPLING 16 /**< Most conversions averaged into one reading. */
+#define HTU21D_BREAKER_THRESHOLD 3 /**< Default htu21d_dev_t::breaker_threshold. */
+
+/**
+ * @brief How a measurement waits for the sensor's conversion.
+ */
+typedef enum {
+    HTU21D_READ_MODE_FIXED_WAIT = 0, /**< No hold master, wait the datasheet's max conversion time, then read. */
+    HTU21D_READ_MODE_POLLING,        /**< No hold master, wait the typical conversion time, then poll until the sensor ACKs. */
+    HTU21D_READ_MODE_HOLD,           /**< Hold master, the sensor stretches SCL until the conversion is done. Needs a
+                                          controller that tolerates clock stretching of up to 50 ms. */
+} htu21d_read_mode_t;
+
+/**
+ * @brief One HTU21D sensor, wired straight to a bus or behind a
+ * TCA9548A-compatible I2C mux.
+ *
+ * Allocated by the caller (statically, on the stack or on the heap) and set up
+ * with htu21d_dev_init(). The `htu21d_*()` functions without a device use a
+ * default one, see htu21d_get_default_dev().
+ */
+typedef struct {
+    i2c_port_t port;              /**< I2C port the sensor (or its mux) is on. */
+    uint8_t mux_address;          /**< I2C address of the mux, or #HTU21D_NO_MUX. */
+    uint8_t mux_channel;          /**< Mux channel (0-7) the sensor is on. */
+    htu21d_read_mode_t read_mode; /**< How measurements wait for the conversion. */
+    uint8_t resolution;           /**< Resolution bits as last read/written, selects the conversion time. */
+    uint8_t pending_command;      /**< Measurement started with htu21d_dev_start_measurement(), or 0. */
+    uint8_t user_register;        /**< User register as last read/written, for the heater and battery flags. */
+    uint8_t temperature_oversampling; /**< Temperature conversions averaged per reading (1-16, 0 counts as 1). */
+    uint8_t humidity_oversampling;    /**< Humidity conversions averaged per reading (1-16, 0 counts as 1). */
+    uint8_t breaker_threshold;    /**< Consecutive failed measurements after which the sensor is only probed now
+                                       and then, measurements failing fast meanwhile (0: never). */
+    uint8_t failures;             /**< Consecutive failed measurements. */
+    uint32_t backoff_ms;          /**< Time from a failed probe to the next one, doubling up to a minute. */
+    uint64_t retry_us;            /**< When the next probe is due, see htu21d_port_time_us(). */
+    uint64_t pending_done_us;     /**< When the pending measurement is done at the latest. */
+} htu21d_dev_t;
+
+/**
+ * @brief Noise (standard deviation) of a single conversion at one resolution.
+ */
+typedef struct {
+    uint8_t resolution;           /**< Resolution bits of the user register. */
+    float temperature;            /**< degC. */
+    float humidity;               /**< %RH. */
+} htu21d_noise_t;
+
+/**
+ * @brief What a temperature + humidity reading must achieve, for
+ * htu21d_plan(). Zero means "don't care".
+ */
+typedef struct {
+    float temperature_noise;      /**< Max noise of a temperature reading, degC. */
+    float humidity_noise;         /**< Max noise of a humidity reading, %RH. */
+    uint32_t latency_ms;          /**< Max conversion time of a T+RH reading. */
+    float energy_uj;              /**< Max sensor energy of a T+RH reading, uJ. */
+} htu21d_goal_t;
+
+/**
+ * @brief Resolution and oversampling picked by htu21d_plan().
+ */
+typedef struct {
+    uint8_t resolution;               /**< Resolution bits of the user register. */
+    uint8_t temperature_oversampling; /**< Temperature conversions averaged per reading. */
+    uint8_t humidity_oversampling;    /**< Humidity conversions averaged per reading. */
+    float temperature_noise;          /**< Expected noise of a temperature reading, degC. */
+    float humidity_noise;             /**< Expected noise of a humidity reading, %RH. */
+    uint32_t latency_ms;              /**< Worst case conversion time of a T+RH reading. */
+    float energy_uj;                  /**< Sensor energy of a T+RH reading, uJ. */
+} htu21d_plan_t;
+
+/**
+ * @brief Psychrometric state of moist air, see htu21d_compute_moist_air().
+ */
+typedef struct {
+    float humidity_ratio;         /**< Water vapor per dry air, kg/kg. */
+    float enthalpy;               /**< Specific enthalpy per dry air, kJ/kg. */
+} htu21d_moist_air_t;
+
+// htu21d_sample_t::flags
+#define HTU21D_SAMPLE_CRC_OK            0x01 /**< Every conversion passed its CRC check. */
+#define HTU21D_SAMPLE_RETRIED           0x02 /**< A conversion was repeated after a CRC error. */
+#define HTU21D_SAMPLE_STALE             0x04 /**< Served from a cache, not measured for this request. */
+#define HTU21D_SAMPLE_OUT_OF_RANGE      0x08 /**< Outside -40..125 degC or 0..100 %RH. */
+#define HTU21D_SAMPLE_HEATER_ON         0x10 /**< The on-chip heater was on (as last read from the user register). */
+#define HTU21D_SAMPLE_LOW_BATTERY       0x20 /**< VDD below 2.25 V (as last read from the user register). */
+#define HTU21D_SAMPLE_RESOLUTION_MASK   0xC0 /**< Resolution index, see HTU21D_SAMPLE_RESOLUTION(). */
+#define HTU21D_SAMPLE_RESOLUTION_SHIFT  6
+
+/**
+ * @brief Resolution bits of the user register from htu21d_sample_t::flags.
+ */
+#define HTU21D_SAMPLE_RESOLUTION(flags) \
+    ((uint8_t)((((flags) & 0x80) ? 0x80 : 0x00) | (((flags) & 0x40) ? 0x01 : 0x00)))
+
+/**
+ * @brief A temperature + humidity reading kept as the sensor's raw codes.
+ *
+ * Nothing is converted when the sample is taken. The htu21d_sample_*()
+ * accessors convert on first use and cache the result in the record, so
+ * samples that are only stored or compared raw never pay for the float math.
+ *
+ * htu21d_sample_t::flags packs the quality of the reading into one byte, so
+ * consumers can drop suspect samples with a single mask test, e.g.
+ * `(flags & (HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_OUT_OF_RANGE)) ==
+ * HTU21D_SAMPLE_CRC_OK`.
+ *
+ * Store or transmit the raw codes, resolution, flags and timestamp_us (the
+ * arguments of htu21d_sample_from_raw()), and rebuild a record from them with
+ * it. htu21d_sample_t::converted and the cached values are not worth keeping.
+ */
+typedef struct {
+    uint16_t raw_temperature;     /**< Temperature code, status bits cleared. */
+    uint16_t raw_humidity;        /**< Humidity code, status bits cleared. */
+    uint8_t resolution;           /**< Resolution bits the codes were measured at. */
+    uint8_t flags;                /**< `HTU21D_SAMPLE_*` quality flags and resolution. */
+    uint8_t converted;            /**< Which of the cached values below are valid. */
+    uint64_t timestamp_us;        /**< htu21d_port_time_us() when the reading started. */
+    float temperature;            /**< Cached, read with htu21d_sample_temperature(). */
+    float humidity;               /**< Cached, read with htu21d_sample_humidity(). */
+    float compensated_humidity;   /**< Cached, read with htu21d_sample_compensated_humidity(). */
+    float dew_point;              /**< Cached, read with htu21d_sample_dew_point(). */
+} htu21d_sample_t;
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,12 +214,58 @@ uint8_t htu21d_read_user_register();
 int htu21d_write_user_register(uint8_t value);
 uint16_t read_value(uint8_t command);
 bool is_crc_valid(uint16_t value, uint8_t crc);
+float htu21d_raw_to_temperature(uint16_t raw_temperature);
+float htu21d_raw_to_humidity(uint16_t raw_humidity);
+uint32_t htu21d_conversion_time_ms(uint8_t resolution, uint8_t command);
+
+// multi-sensor functions
+int htu21d_bus_init(i2c_port_t port, int sda_pin, int scl_pin, gpio_pullup_t sda_internal_pullup, gpio_pullup_t scl_internal_pullup);
+int htu21d_dev_init(htu21d_dev_t *dev, i2c_port_t port, uint8_t mux_address, uint8_t mux_channel);
+htu21d_dev_t *htu21d_get_default_dev();
+float htu21d_dev_read_temperature(htu21d_dev_t *dev);
+float htu21d_dev_read_humidity(htu21d_dev_t *dev);
+uint8_t htu21d_dev_get_resolution(htu21d_dev_t *dev);
+int htu21d_dev_set_resolution(htu21d_dev_t *dev, uint8_t resolution);
+int htu21d_dev_soft_reset(htu21d_dev_t *dev);
+uint8_t htu21d_dev_read_user_register(htu21d_dev_t *dev);
+int htu21d_dev_load_user_register(htu21d_dev_t *dev);
+int htu21d_dev_write_user_register(htu21d_dev_t *dev, uint8_t value);
+uint16_t htu21d_dev_read_value(htu21d_dev_t *dev, uint8_t command);
+int htu21d_dev_measure(htu21d_dev_t *dev, uint8_t command, uint16_t *raw_value);
+int htu21d_dev_start_measurement(htu21d_dev_t *dev, uint8_t command);
+int htu21d_dev_fetch_measurement(htu21d_dev_t *dev, uint16_t *raw_value);
+
+// raw samples, converted on first access
+int htu21d_read_sample(htu21d_sample_t *sample);
+int htu21d_dev_read_sample(htu21d_dev_t *dev, htu21d_sample_t *sample);
+void htu21d_sample_from_raw(htu21d_sample_t *sample, uint16_t raw_temperature, uint16_t raw_humidity,
+                            uint8_t resolution, uint8_t flags, uint64_t timestamp_us);
+float htu21d_sample_temperature(htu21d_sample_t *sample);
+float htu21d_sample_humidity(htu21d_sample_t *sample);
+#if CONFIG_HTU21D_DERIVED_MATH
+float htu21d_sample_compensated_humidity(htu21d_sample_t *sample);
+float htu21d_sample_dew_point(htu21d_sample_t *sample);
+#endif
+
+// oversampling planner
+int htu21d_plan(const htu21d_goal_t *goal, const htu21d_noise_t noise[HTU21D_RESOLUTIONS], htu21d_plan_t *plan);
+int htu21d_dev_apply_plan(htu21d_dev_t *dev, const htu21d_plan_t *plan);
+int htu21d_resolution_noise(uint8_t resolution, const htu21d_noise_t noise[HTU21D_RESOLUTIONS],
+                            htu21d_noise_t *single);
 
 // Extra functions:
 float celsius_to_fahrenheit(float celsius_degrees);
+#if CONFIG_HTU21D_DERIVED_MATH
 float htu21_compute_compensated_humidity(float temperature, float relative_humidity);
 float htu21d_compute_partial_pressure(float temperature);
 float htu21d_compute_dew_point(float temperature, float relative_humidity);
+float htu21d_compute_humidity_ratio(float temperature, float relative_humidity, float pressure_kpa);
+float htu21d_compute_enthalpy(float temperature, float humidity_ratio);
+void htu21d_compute_moist_air(float temperature, float relative_humidity, float pressure_kpa,
+                              htu21d_moist_air_t *air);
+void htu21d_compute_moist_air_batch(const float *temperature, const float *relative_humidity, float pressure_kpa,
+                                    size_t count, htu21d_moist_air_t *air);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,122 @@
+/**
+ * @file htu21d_accumulator.c
+ * @brief Running degree-days and time above/below temperature and humidity
+ * thresholds.
+ *
+ * Every total is the integral of `max(0, v(t))` or of `v(t) > 0` for a
+ * margin `v` that is linear between two samples, e.g. `heating_base - T`.
+ * When the margin changes sign within the interval only the part before or
+ * after the crossing counts.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stddef.h>
+#include "htu21d_accumulator.h"
+
+/**
+ * @brief Length of `[0, duration]` where the margin going linearly from
+ * `from` to `to` is positive.
+ */
+static float positive_time(float from, float to, float duration)
+{
+    if (from > 0 && to > 0) {
+        return duration;
+    }
+    if (from <= 0 && to <= 0) {
+        return 0;
+    }
+    float positive = from > 0 ? from : to;
+    return duration * positive / (positive - (from > 0 ? to : from));
+}
+
+/**
+ * @brief Integral of the positive part of the margin going linearly from
+ * `from` to `to` over `duration`.
+ */
+static float positive_area(float from, float to, float duration)
+{
+    if (from >= 0 && to >= 0) {
+        return 0.5F * (from + to) * duration;
+    }
+    float positive = from > to ? from : to;
+    return positive > 0 ? 0.5F * positive * positive_time(from, to, duration) : 0;
+}
+
+static uint64_t rounded(float value)
+{
+    return (uint64_t)(value + 0.5F);
+}
+
+/**
+ * @brief Prepares an accumulator.
+ * @param totals Totals saved from a previous run to continue from, or `NULL`
+ * to start at zero.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if `config` is
+ * missing.
+ */
+int htu21d_accumulator_init(htu21d_accumulator_t *accumulator, const htu21d_accumulator_config_t *config,
+                            const htu21d_totals_t *totals)
+{
+    if (accumulator == NULL || config == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    *accumulator = (htu21d_accumulator_t) {
+        .config = *config,
+        .started = false,
+    };
+    if (totals != NULL) {
+        accumulator->totals = *totals;
+    }
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Integrates from the previous sample to this one.
+ *
+ * Samples without #HTU21D_SAMPLE_CRC_OK are skipped. After a gap longer than
+ * htu21d_accumulator_config_t::max_gap_s integration restarts at this sample.
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_CRC for a skipped sample, or
+ * #HTU21D_ERR_INVALID_ARG if the sample is older than the previous one
+ * (integration restarts at it).
+ */
+int htu21d_accumulator_add(htu21d_accumulator_t *accumulator, htu21d_sample_t *sample)
+{
+    const htu21d_accumulator_config_t *config = &accumulator->config;
+    htu21d_totals_t *totals = &accumulator->totals;
+
+    if (!(sample->flags & HTU21D_SAMPLE_CRC_OK)) {
+        return HTU21D_ERR_CRC;
+    }
+    float t1 = htu21d_sample_temperature(sample), rh1 = htu21d_sample_humidity(sample);
+    float t0 = accumulator->last_temperature, rh0 = accumulator->last_humidity;
+    bool started = accumulator->started;
+    uint64_t last_us = accumulator->last_us;
+
+    accumulator->last_us = sample->timestamp_us;
+    accumulator->last_temperature = t1;
+    accumulator->last_humidity = rh1;
+    accumulator->started = true;
+    if (!started) {
+        return HTU21D_ERR_OK;
+    }
+    if (sample->timestamp_us < last_us) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    uint64_t elapsed_us = sample->timestamp_us - last_us;
+    if (config->max_gap_s > 0 && elapsed_us > config->max_gap_s * 1000000ULL) {
+        return HTU21D_ERR_OK;
+    }
+
+    float ms = elapsed_us / 1000.0F;
+    totals->heating_mdeg_s += rounded(positive_area(config->heating_base - t0, config->heating_base - t1, ms));
+    totals->cooling_mdeg_s += rounded(positive_area(t0 - config->cooling_base, t1 - config->cooling_base, ms));
+    totals->temperature_above_ms += rounded(positive_time(t0 - config->temperature_high,
+                                                          t1 - config->temperature_high, ms));
+    totals->temperature_below_ms += rounded(positive_time(config->temperature_low - t0,
+                                                          config->temperature_low - t1, ms));
+    totals->humidity_above_ms += rounded(positive_time(rh0 - config->humidity_high, rh1 - config->humidity_high, ms));
+    totals->humidity_below_ms += rounded(positive_time(config->humidity_low - rh0, config->humidity_low - rh1, ms));
+    totals->covered_ms += elapsed_us / 1000;
+    return HTU21D_ERR_OK;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file htu21d_accumulator.h
+ * @brief Running degree-days and time above/below temperature and humidity
+ * thresholds.
+ *
+ * Integrates over the sample stream with the trapezoidal rule on the
+ * samples' own timestamps, so irregular sampling is handled. Between two
+ * samples the values are taken as linear, so an interval that crosses a
+ * threshold or base temperature counts only the part on the far side. Each
+ * sample costs O(1).
+ *
+ * The totals are plain integers in htu21d_totals_t, which can be written to
+ * flash or RTC memory as is and handed back to htu21d_accumulator_init()
+ * after a restart.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_ACCUMULATOR_H__
+#define __HTU21D_ACCUMULATOR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+#define HTU21D_MDEG_S_PER_DEGREE_DAY    86400000.0 /**< htu21d_totals_t degree-time units per degree-day. */
+
+/**
+ * @brief Base temperatures and thresholds.
+ */
+typedef struct {
+    float heating_base;           /**< Heating degree-days count time below this, degC (e.g. 18). */
+    float cooling_base;           /**< Cooling degree-days count time above this, degC (e.g. 18 or 22). */
+    float temperature_high;       /**< Time above this temperature is counted, degC. */
+    float temperature_low;        /**< Time below this temperature is counted, degC. */
+    float humidity_high;          /**< Time above this humidity is counted, %RH. */
+    float humidity_low;           /**< Time below this humidity is counted, %RH. */
+    uint32_t max_gap_s;           /**< Longer gaps between samples are not integrated (0: no limit). */
+} htu21d_accumulator_config_t;
+
+/**
+ * @brief Totals since the accumulator was started, in integer units so they
+ * add up without rounding drift and persist as is.
+ */
+typedef struct {
+    uint64_t heating_mdeg_s;      /**< Heating degree-time, mdegC x s, see #HTU21D_MDEG_S_PER_DEGREE_DAY. */
+    uint64_t cooling_mdeg_s;      /**< Cooling degree-time, mdegC x s. */
+    uint64_t temperature_above_ms; /**< Time above htu21d_accumulator_config_t::temperature_high. */
+    uint64_t temperature_below_ms; /**< Time below htu21d_accumulator_config_t::temperature_low. */
+    uint64_t humidity_above_ms;   /**< Time above htu21d_accumulator_config_t::humidity_high. */
+    uint64_t humidity_below_ms;   /**< Time below htu21d_accumulator_config_t::humidity_low. */
+    uint64_t covered_ms;          /**< Time integrated, gaps excluded. */
+} htu21d_totals_t;
+
+/**
+ * @brief Accumulator state.
+ */
+typedef struct {
+    htu21d_accumulator_config_t config;
+    htu21d_totals_t totals;
+    uint64_t last_us;             /**< Timestamp of the previous sample. */
+    float last_temperature;       /**< Temperature of the previous sample. */
+    float last_humidity;          /**< Humidity of the previous sample. */
+    bool started;                 /**< False until the first good sample. */
+} htu21d_accumulator_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_accumulator_init(htu21d_accumulator_t *accumulator, const htu21d_accumulator_config_t *config,
+                            const htu21d_totals_t *totals);
+int htu21d_accumulator_add(htu21d_accumulator_t *accumulator, htu21d_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_ACCUMULATOR_H__
@@ -0,0 +1,154 @@
+/**
+ * @file htu21d_anomaly.c
+ * @brief Change-point detection on the sample stream, per sample and in
+ * constant memory.
+ *
+ * Per channel and sample, with `z = (x - mean) / sigma`:
+ *
+ * - `cusum_up = max(0, cusum_up + z - slack)`, likewise `cusum_down` with
+ *   `-z`; a shift is signaled when either exceeds the limit
+ * - `ewma += weight * (x - ewma)`; a shift is signaled when it leaves
+ *   `mean +- limit * sigma * sqrt(weight / (2 - weight))`
+ * - the baseline mean and variance follow the stream as exponentially
+ *   weighted averages (plain averages during warmup), and sigma is kept at or
+ *   above the channel's noise floor
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include "htu21d_anomaly.h"
+
+static float channel_value(htu21d_sample_t *sample, htu21d_anomaly_channel_t channel)
+{
+    switch (channel) {
+    case HTU21D_ANOMALY_TEMPERATURE:
+        return htu21d_sample_temperature(sample);
+    case HTU21D_ANOMALY_HUMIDITY:
+        return htu21d_sample_humidity(sample);
+#if CONFIG_HTU21D_DERIVED_MATH
+    case HTU21D_ANOMALY_DEW_POINT:
+        return htu21d_sample_dew_point(sample);
+#endif
+    default:
+        return NAN;
+    }
+}
+
+/**
+ * @brief Runs both charts of one channel.
+ * @return Returns the `HTU21D_ANOMALY_*` bits of the shifts signaled.
+ */
+static uint8_t check(const htu21d_anomaly_config_t *config, htu21d_anomaly_state_t *state, float value,
+                     float min_sigma, bool armed)
+{
+    float sigma = sqrtf(state->variance);
+    sigma = sigma > min_sigma ? sigma : min_sigma;
+    float z = (value - state->mean) / sigma;
+    uint8_t kind = 0;
+
+    state->cusum_up = fmaxf(0, state->cusum_up + z - config->cusum_slack);
+    state->cusum_down = fmaxf(0, state->cusum_down - z - config->cusum_slack);
+    state->ewma += config->ewma_weight * (value - state->ewma);
+    float ewma_limit = config->ewma_limit * sigma * sqrtf(config->ewma_weight / (2 - config->ewma_weight));
+
+    if (!armed) {
+        // still learning the baseline: start the charts afresh once it is known
+        state->cusum_up = 0;
+        state->cusum_down = 0;
+        state->ewma = value;
+        return 0;
+    }
+    kind |= state->cusum_up > config->cusum_limit ? HTU21D_ANOMALY_CUSUM_UP : 0;
+    kind |= state->cusum_down > config->cusum_limit ? HTU21D_ANOMALY_CUSUM_DOWN : 0;
+    kind |= state->ewma > state->mean + ewma_limit ? HTU21D_ANOMALY_EWMA_UP : 0;
+    kind |= state->ewma < state->mean - ewma_limit ? HTU21D_ANOMALY_EWMA_DOWN : 0;
+    return kind;
+}
+
+/**
+ * @brief Prepares a detector.
+ * @param config Tuning, or `NULL` for #HTU21D_ANOMALY_CONFIG_DEFAULT.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if a weight is
+ * not within (0, 1] or a limit is not positive.
+ */
+int htu21d_anomaly_init(htu21d_anomaly_t *detector, const htu21d_anomaly_config_t *config)
+{
+    static const htu21d_anomaly_config_t defaults = HTU21D_ANOMALY_CONFIG_DEFAULT;
+
+    if (detector == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    if (config == NULL) {
+        config = &defaults;
+    }
+    if (!(config->ewma_weight > 0 && config->ewma_weight <= 1) || !(config->baseline_weight > 0 &&
+            config->baseline_weight <= 1) || !(config->ewma_limit > 0) || !(config->cusum_limit > 0) ||
+            config->cusum_slack < 0) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    *detector = (htu21d_anomaly_t) {
+        .config = *config,
+        .samples = 0,
+    };
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Takes the next sample into account.
+ *
+ * Samples without #HTU21D_SAMPLE_CRC_OK are ignored. A channel that signals a
+ * shift restarts its charts with the sample's value as the new baseline
+ * level, so each shift is reported once.
+ * @param sample Converted as needed, see htu21d_sample_temperature().
+ * @param[out] events Shifts signaled by this sample, at most one per channel.
+ * @return Returns the number of events written.
+ */
+int htu21d_anomaly_update(htu21d_anomaly_t *detector, htu21d_sample_t *sample,
+                          htu21d_anomaly_event_t events[HTU21D_ANOMALY_CHANNELS])
+{
+    const htu21d_anomaly_config_t *config = &detector->config;
+    int count = 0;
+
+    if (!(sample->flags & HTU21D_SAMPLE_CRC_OK)) {
+        return 0;
+    }
+    detector->samples++;
+    bool armed = detector->samples > config->warmup;
+    float weight = 1.0F / detector->samples;
+    weight = weight > config->baseline_weight ? weight : config->baseline_weight;
+
+    for (int c = 0; c < HTU21D_ANOMALY_CHANNELS; c++) {
+        htu21d_anomaly_state_t *state = &detector->channels[c];
+        float value = channel_value(sample, (htu21d_anomaly_channel_t) c);
+        if (isnan(value)) {
+            continue;
+        }
+        if (detector->samples == 1) {
+            state->mean = value;
+            state->ewma = value;
+        }
+
+        uint8_t kind = check(config, state, value, config->min_sigma[c], armed);
+        if (kind) {
+            events[count++] = (htu21d_anomaly_event_t) {
+                .timestamp_us = sample->timestamp_us,
+                .channel = (htu21d_anomaly_channel_t) c,
+                .kind = kind,
+                .value = value,
+                .baseline = state->mean,
+            };
+            state->mean = value;
+            state->ewma = value;
+            state->cusum_up = 0;
+            state->cusum_down = 0;
+            continue;
+        }
+
+        float deviation = value - state->mean;
+        state->mean += weight * deviation;
+        state->variance = (1 - weight) * (state->variance + weight * deviation * deviation);
+    }
+    return count;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file htu21d_anomaly.h
+ * @brief Change-point detection on the sample stream, per sample and in
+ * constant memory.
+ *
+ * Each channel (temperature, humidity and dew point) runs two control charts
+ * against a baseline mean and noise level learned from the stream itself:
+ *
+ * - CUSUM, which accumulates small deviations and catches a sustained shift
+ *   of about one sigma within a handful of samples (a door left open, a leak)
+ * - EWMA, a smoothed value with control limits, which catches slow drifts and
+ *   large jumps (a failing sensor)
+ *
+ * An event is reported once per detected shift, after which the channel
+ * adopts the new level as its baseline. A node can then send only the events
+ * and periodic summaries (see htu21d_history_stats()) instead of every
+ * reading.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_ANOMALY_H__
+#define __HTU21D_ANOMALY_H__
+
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief A monitored value of a sample.
+ */
+typedef enum {
+    HTU21D_ANOMALY_TEMPERATURE,   /**< htu21d_sample_temperature(), degC. */
+    HTU21D_ANOMALY_HUMIDITY,      /**< htu21d_sample_humidity(), %RH. */
+    HTU21D_ANOMALY_DEW_POINT,     /**< htu21d_sample_dew_point(), degC. Skipped without #CONFIG_HTU21D_DERIVED_MATH. */
+    HTU21D_ANOMALY_CHANNELS,
+} htu21d_anomaly_channel_t;
+
+#define HTU21D_ANOMALY_CUSUM_UP     0x01 /**< CUSUM detected an upward shift. */
+#define HTU21D_ANOMALY_CUSUM_DOWN   0x02 /**< CUSUM detected a downward shift. */
+#define HTU21D_ANOMALY_EWMA_UP      0x04 /**< The EWMA rose above its upper control limit. */
+#define HTU21D_ANOMALY_EWMA_DOWN    0x08 /**< The EWMA fell below its lower control limit. */
+
+/**
+ * @brief Detector tuning. Limits are in sigmas of the channel's noise.
+ */
+typedef struct {
+    float ewma_weight;            /**< Weight of a new sample in the EWMA chart (0-1). */
+    float ewma_limit;             /**< EWMA control limit, sigmas of the EWMA statistic. */
+    float cusum_slack;            /**< Deviations below this many sigmas don't accumulate. */
+    float cusum_limit;            /**< Accumulated sigmas that signal a shift. */
+    float baseline_weight;        /**< Weight of a new sample in the learned mean and variance. */
+    float min_sigma[HTU21D_ANOMALY_CHANNELS]; /**< Noise floor per channel, so a quiet signal doesn't alarm on one code. */
+    uint16_t warmup;              /**< Samples learned before events are reported. */
+} htu21d_anomaly_config_t;
+
+/**
+ * @brief Flags a sustained shift of 2 sigmas within about 4 samples. The
+ * noise floors are several times the sensor noise at the default resolution,
+ * so sensor noise alone practically never alarms.
+ */
+#define HTU21D_ANOMALY_CONFIG_DEFAULT {                                         \
+        .ewma_weight = 0.2F,                                                    \
+        .ewma_limit = 3.0F,                                                     \
+        .cusum_slack = 0.5F,                                                    \
+        .cusum_limit = 5.0F,                                                    \
+        .baseline_weight = 1.0F / 256,                                          \
+        .min_sigma = {0.05F, 0.3F, 0.1F},                                       \
+        .warmup = 32,                                                           \
+    }
+
+/**
+ * @brief State of one channel.
+ */
+typedef struct {
+    float mean;                   /**< Baseline level. */
+    float variance;               /**< Baseline noise, squared. */
+    float ewma;                   /**< EWMA chart statistic. */
+    float cusum_up;               /**< Accumulated upward deviation, sigmas. */
+    float cusum_down;             /**< Accumulated downward deviation, sigmas. */
+} htu21d_anomaly_state_t;
+
+/**
+ * @brief Detector for one sensor.
+ */
+typedef struct {
+    htu21d_anomaly_config_t config;
+    htu21d_anomaly_state_t channels[HTU21D_ANOMALY_CHANNELS];
+    uint32_t samples;             /**< Samples taken into account. */
+} htu21d_anomaly_t;
+
+/**
+ * @brief A detected shift.
+ */
+typedef struct {
+    uint64_t timestamp_us;        /**< htu21d_sample_t::timestamp_us of the sample that signaled it. */
+    htu21d_anomaly_channel_t channel;
+    uint8_t kind;                 /**< `HTU21D_ANOMALY_CUSUM_*` and `HTU21D_ANOMALY_EWMA_*` bits. */
+    float value;                  /**< The channel's value in that sample. */
+    float baseline;               /**< The level before the shift. */
+} htu21d_anomaly_event_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_anomaly_init(htu21d_anomaly_t *detector, const htu21d_anomaly_config_t *config);
+int htu21d_anomaly_update(htu21d_anomaly_t *detector, htu21d_sample_t *sample,
+                          htu21d_anomaly_event_t events[HTU21D_ANOMALY_CHANNELS]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_ANOMALY_H__
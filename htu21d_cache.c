@@ -0,0 +1,157 @@
+/**
+ * @file htu21d_cache.c
+ * @brief Shared, max-age cached readings of one sensor for several tasks.
+ *
+ * htu21d_cache_t::generation works as a sequence lock: the measuring caller
+ * makes it odd, writes the result and makes it even again. Readers copy the
+ * result and retry if the count changed meanwhile. A waiting caller only
+ * needs to see the count move past the value it started from, or
+ * htu21d_cache_t::busy drop without it, when the caller holding it backed off
+ * and the waiter has to measure itself.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stddef.h>
+#include "htu21d_cache.h"
+#include "htu21d_port.h"
+
+#define HTU21D_CACHE_POLL_MS    1 /**< Sleep between checks while another caller measures. */
+
+/**
+ * @brief Copies the published result.
+ * @return Returns the generation the copy belongs to.
+ */
+static uint32_t snapshot(htu21d_cache_t *cache, htu21d_sample_t *sample, int *result, bool *has_sample)
+{
+    for (;;) {
+        uint32_t generation = __atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE);
+        if (generation & 1) {
+            // being published, let the writer finish
+            htu21d_port_delay_ms(HTU21D_CACHE_POLL_MS);
+            continue;
+        }
+        *sample = cache->sample;
+        *result = cache->result;
+        *has_sample = cache->has_sample;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&cache->generation, __ATOMIC_RELAXED) == generation) {
+            return generation;
+        }
+    }
+}
+
+/**
+ * @brief Hands out the last reading, flagged, while the sensor's circuit
+ * breaker keeps it off the bus.
+ */
+static void fall_back(int result, const htu21d_sample_t *cached, bool has_sample, htu21d_sample_t *sample)
+{
+    if (result == HTU21D_ERR_UNAVAILABLE && has_sample) {
+        *sample = *cached;
+        sample->flags |= HTU21D_SAMPLE_STALE;
+    }
+}
+
+/**
+ * @brief Measures for every caller and publishes the result.
+ */
+static int measure(htu21d_cache_t *cache, htu21d_sample_t *sample)
+{
+    htu21d_sample_t measured;
+    int ret = htu21d_dev_read_sample(cache->dev, &measured);
+
+    __atomic_fetch_add(&cache->generation, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    cache->result = ret;
+    if (ret == HTU21D_ERR_OK) {
+        cache->sample = measured;
+        cache->has_sample = true;
+        *sample = measured;
+    }
+    fall_back(ret, &cache->sample, cache->has_sample, sample);
+    __atomic_fetch_add(&cache->generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&cache->busy, 0, __ATOMIC_RELEASE);
+    return ret;
+}
+
+/**
+ * @brief Prepares an empty cache in front of `dev`.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG.
+ */
+int htu21d_cache_init(htu21d_cache_t *cache, htu21d_dev_t *dev)
+{
+    if (cache == NULL || dev == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    cache->dev = dev;
+    cache->result = HTU21D_ERR_OK;
+    cache->has_sample = false;
+    __atomic_store_n(&cache->busy, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->generation, 0, __ATOMIC_RELEASE);
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Returns a reading at most `max_age_us` old, measuring only if there
+ * is none, from any number of tasks at once.
+ *
+ * A cached reading comes with #HTU21D_SAMPLE_STALE added to its flags. A
+ * caller that finds a measurement in flight waits for it and shares its
+ * result, whatever its own `max_age_us`.
+ * @param max_age_us Oldest acceptable reading, by its htu21d_sample_t::timestamp_us;
+ * `0` always waits for a new measurement.
+ * @return Returns #HTU21D_ERR_OK, or the error of the measurement that failed
+ * (the sample is left unchanged then). With #HTU21D_ERR_UNAVAILABLE, from a
+ * sensor whose circuit breaker is open, the last reading is returned anyway
+ * whatever its age, flagged #HTU21D_SAMPLE_STALE.
+ */
+int htu21d_read_cached(htu21d_cache_t *cache, uint64_t max_age_us, htu21d_sample_t *sample)
+{
+    htu21d_sample_t cached;
+    int result;
+    bool has_sample;
+
+    if (cache == NULL || sample == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    for (;;) {
+        uint32_t generation = snapshot(cache, &cached, &result, &has_sample);
+        uint64_t now_us = htu21d_port_time_us();
+        if (has_sample && max_age_us > 0 && now_us - cached.timestamp_us <= max_age_us) {
+            *sample = cached;
+            sample->flags |= HTU21D_SAMPLE_STALE;
+            return HTU21D_ERR_OK;
+        }
+
+        uint32_t idle = 0;
+        if (__atomic_compare_exchange_n(&cache->busy, &idle, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            if (__atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE) != generation) {
+                // a measurement finished since the snapshot, it may do
+                __atomic_store_n(&cache->busy, 0, __ATOMIC_RELEASE);
+                continue;
+            }
+            return measure(cache, sample);
+        }
+
+        // another caller is measuring: wait for its result and share it
+        bool abandoned = false;
+        while (__atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE) == generation) {
+            if (__atomic_load_n(&cache->busy, __ATOMIC_ACQUIRE) == 0) {
+                // it backed off without measuring, e.g. content with an older reading
+                abandoned = true;
+                break;
+            }
+            htu21d_port_delay_ms(HTU21D_CACHE_POLL_MS);
+        }
+        if (abandoned) {
+            continue;
+        }
+        snapshot(cache, &cached, &result, &has_sample);
+        if (result == HTU21D_ERR_OK) {
+            *sample = cached;
+        }
+        fall_back(result, &cached, has_sample, sample);
+        return result;
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file htu21d_cache.h
+ * @brief Shared, max-age cached readings of one sensor for several tasks.
+ *
+ * Tasks that read the same sensor each say how old a reading they accept.
+ * A recent enough reading is returned right away, flagged
+ * #HTU21D_SAMPLE_STALE. Otherwise one caller measures, and every caller that
+ * arrives while that measurement is in flight waits for it and gets the same
+ * result instead of starting its own (single-flight), so the sensor sees one
+ * measurement however many tasks ask.
+ *
+ * Lock-free on the GCC/Clang `__atomic` builtins like htu21d_queue.h: the
+ * published reading is guarded by a sequence count, and waiting callers
+ * sleep in 1 ms steps rather than spin, so a waiting high priority task never
+ * starves the one measuring. Every task must read the sensor through the
+ * same cache, since the driver itself is not thread-safe.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_CACHE_H__
+#define __HTU21D_CACHE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief Cache of one sensor, treat as opaque.
+ */
+typedef struct {
+    htu21d_dev_t *dev;
+    uint32_t busy;                /**< 1 while a caller measures for everyone. */
+    uint32_t generation;          /**< Twice the measurements finished, odd while one is being published. */
+    int result;                   /**< Status of the last measurement. */
+    bool has_sample;              /**< False until the first successful measurement. */
+    htu21d_sample_t sample;       /**< Last successful measurement. */
+} htu21d_cache_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_cache_init(htu21d_cache_t *cache, htu21d_dev_t *dev);
+int htu21d_read_cached(htu21d_cache_t *cache, uint64_t max_age_us, htu21d_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_CACHE_H__
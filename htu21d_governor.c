@@ -0,0 +1,135 @@
+/**
+ * @file htu21d_governor.c
+ * @brief Keeps a sensor's measurement duty cycle below a self-heating limit.
+ *
+ * The bucket holds measuring time in us and drains by `duty_permille` us per
+ * ms. A reading may start when its datasheet duration still fits under the
+ * capacity of `duty_permille * window_ms` us, or when the bucket is empty;
+ * the time it really took is charged afterwards.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stddef.h>
+#include "htu21d_governor.h"
+#include "htu21d_port.h"
+
+/**
+ * @brief Empties the bucket by the budget earned since the last update.
+ */
+static void drain(htu21d_governor_t *governor, uint64_t now_us)
+{
+    uint64_t drained_us = (now_us - governor->updated_us) * governor->config.duty_permille / 1000;
+
+    governor->level_us = governor->level_us > drained_us ? governor->level_us - drained_us : 0;
+    governor->updated_us = now_us;
+}
+
+/**
+ * @brief Datasheet duration of a reading at the device's resolution and
+ * oversampling, us.
+ */
+static uint64_t expected_us(const htu21d_dev_t *dev)
+{
+    uint32_t ms = htu21d_conversion_time_ms(dev->resolution, TRIGGER_TEMP_MEASURE_NOHOLD) *
+                  dev->temperature_oversampling +
+                  htu21d_conversion_time_ms(dev->resolution, TRIGGER_HUMD_MEASURE_NOHOLD) *
+                  dev->humidity_oversampling;
+    return ms * 1000ULL;
+}
+
+/**
+ * @brief Puts a sensor under a duty cycle budget, starting with the full
+ * budget available.
+ * @param config Budget, or `NULL` for #HTU21D_GOVERNOR_CONFIG_DEFAULT.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG for a duty cycle
+ * outside 1-1000 permille.
+ */
+int htu21d_governor_init(htu21d_governor_t *governor, htu21d_dev_t *dev, const htu21d_governor_config_t *config)
+{
+    static const htu21d_governor_config_t defaults = HTU21D_GOVERNOR_CONFIG_DEFAULT;
+
+    if (governor == NULL || dev == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    if (config == NULL) {
+        config = &defaults;
+    }
+    if (config->duty_permille == 0 || config->duty_permille > 1000) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    *governor = (htu21d_governor_t) {
+        .dev = dev,
+        .config = *config,
+        .level_us = 0,
+        .updated_us = htu21d_port_time_us(),
+        .duty_permille = 0,
+        .has_sample = false,
+    };
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Returns how long the next reading has to wait for the budget, in
+ * ms; `0` if it may start now.
+ */
+uint32_t htu21d_governor_wait_ms(htu21d_governor_t *governor)
+{
+    drain(governor, htu21d_port_time_us());
+
+    uint64_t capacity_us = (uint64_t) governor->config.duty_permille * governor->config.window_ms;
+    uint64_t needed_us = governor->level_us + expected_us(governor->dev);
+    if (governor->level_us == 0 || needed_us <= capacity_us) {
+        return 0;
+    }
+    // a reading longer than the whole capacity waits for an empty bucket
+    uint64_t excess_us = needed_us > capacity_us + governor->level_us ? governor->level_us : needed_us - capacity_us;
+    uint64_t wait_us = (excess_us * 1000 + governor->config.duty_permille - 1) / governor->config.duty_permille;
+    return (uint32_t)((wait_us + 999) / 1000);
+}
+
+/**
+ * @brief Measures temperature and humidity within the duty cycle budget, see
+ * htu21d_dev_read_sample().
+ *
+ * Over budget, the previous reading is copied to `sample` with
+ * #HTU21D_SAMPLE_STALE added if htu21d_governor_config_t::coalesce is set
+ * and there is one, otherwise the call waits until the reading fits.
+ * @return Returns #HTU21D_ERR_OK, or the error of the measurement that failed
+ * (its time is charged all the same).
+ */
+int htu21d_governor_read_sample(htu21d_governor_t *governor, htu21d_sample_t *sample)
+{
+    if (governor == NULL || sample == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    uint32_t wait_ms = htu21d_governor_wait_ms(governor);
+    if (wait_ms > 0) {
+        if (governor->config.coalesce && governor->has_sample) {
+            *sample = governor->sample;
+            sample->flags |= HTU21D_SAMPLE_STALE;
+            return HTU21D_ERR_OK;
+        }
+        htu21d_port_delay_ms(wait_ms);
+    }
+
+    uint64_t start_us = htu21d_port_time_us();
+    int ret = htu21d_dev_read_sample(governor->dev, sample);
+    uint64_t end_us = htu21d_port_time_us();
+
+    drain(governor, end_us);
+    governor->level_us += end_us - start_us;
+    if (governor->last_busy_us != 0 && start_us > governor->last_start_us) {
+        int32_t duty = (int32_t)(governor->last_busy_us * 1000ULL / (start_us - governor->last_start_us));
+        int32_t average = governor->duty_permille;
+        governor->duty_permille = (uint16_t)(average == 0 ? duty : average + (duty - average) / 4);
+    }
+    governor->last_start_us = start_us;
+    governor->last_busy_us = (uint32_t)(end_us - start_us);
+
+    if (ret == HTU21D_ERR_OK) {
+        governor->sample = *sample;
+        governor->has_sample = true;
+    }
+    return ret;
+}
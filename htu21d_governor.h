@@ -0,0 +1,76 @@
+/**
+ * @file htu21d_governor.h
+ * @brief Keeps a sensor's measurement duty cycle below a self-heating limit.
+ *
+ * The datasheet asks for the sensor to be active no more than 10 % of the
+ * time, or it heats itself and reads high. A governor sits in front of one
+ * sensor and charges the time every reading actually took to a leaky bucket
+ * that drains at the allowed duty cycle. Readings run at full speed while the
+ * bucket has room, e.g. a burst after a long pause, and are then spaced out
+ * just enough to stay within the budget: by waiting for the bucket to drain,
+ * or by handing back the previous reading flagged #HTU21D_SAMPLE_STALE.
+ *
+ * The time charged is the wall time of htu21d_dev_read_sample(), an upper
+ * bound of the sensor's active time. #HTU21D_READ_MODE_POLLING and
+ * #HTU21D_READ_MODE_HOLD end close to the actual conversion time, so they
+ * allow the highest sample rate.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_GOVERNOR_H__
+#define __HTU21D_GOVERNOR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief Duty cycle budget.
+ */
+typedef struct {
+    uint16_t duty_permille;       /**< Max share of time spent measuring, 1-1000 permille. */
+    uint32_t window_ms;           /**< Averaging window; up to duty_permille * window_ms / 1000 ms of measurements can run at once, e.g. after a pause. */
+    bool coalesce;                /**< Over budget, serve the last reading instead of waiting. */
+} htu21d_governor_config_t;
+
+/**
+ * @brief The datasheet's 10 % limit, at most 1 s of measurements at once, and
+ * requests wait for the budget.
+ */
+#define HTU21D_GOVERNOR_CONFIG_DEFAULT {                                        \
+        .duty_permille = 100,                                                   \
+        .window_ms = 10000,                                                     \
+        .coalesce = false,                                                      \
+    }
+
+/**
+ * @brief Governor state of one sensor.
+ */
+typedef struct {
+    htu21d_dev_t *dev;
+    htu21d_governor_config_t config;
+    uint64_t level_us;            /**< Measuring time still in the bucket. */
+    uint64_t updated_us;          /**< When htu21d_governor_t::level_us was last drained. */
+    uint64_t last_start_us;       /**< Start of the previous reading. */
+    uint32_t last_busy_us;        /**< Duration of the previous reading. */
+    uint16_t duty_permille;       /**< Measured duty cycle, averaged over the last few readings. */
+    bool has_sample;              /**< False until the first successful reading. */
+    htu21d_sample_t sample;       /**< Last reading, for coalesced requests. */
+} htu21d_governor_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_governor_init(htu21d_governor_t *governor, htu21d_dev_t *dev, const htu21d_governor_config_t *config);
+uint32_t htu21d_governor_wait_ms(htu21d_governor_t *governor);
+int htu21d_governor_read_sample(htu21d_governor_t *governor, htu21d_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_GOVERNOR_H__
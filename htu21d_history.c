@@ -0,0 +1,282 @@
+/**
+ * @file htu21d_history.c
+ * @brief Fixed-capacity in-RAM history of recent samples, stored by column.
+ *
+ * The columns form a ring: sample `index` (0 = oldest) lives at column entry
+ * `(start + index) % capacity`, so a window of samples is at most two
+ * contiguous runs of each column.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "htu21d_history.h"
+
+/**
+ * @brief Running totals of a scan.
+ */
+typedef struct {
+    uint32_t count;
+    uint16_t min_temperature;
+    uint16_t max_temperature;
+    uint16_t min_humidity;
+    uint16_t max_humidity;
+    uint64_t sum_temperature;
+    uint64_t sum_humidity;
+} scan_t;
+
+static uint32_t column(const htu21d_history_t *history, uint32_t index)
+{
+    uint32_t i = history->start + index;
+    return i >= history->capacity ? i - history->capacity : i;
+}
+
+/**
+ * @brief Index of the first sample taken at or after `time_us`.
+ */
+static uint32_t lower_bound(const htu21d_history_t *history, uint64_t time_us)
+{
+    uint32_t low = 0, high = history->count;
+
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (history->timestamps_us[column(history, mid)] < time_us) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Adds column entries `[from, from + len)` to the totals.
+ *
+ * Straight-line loop over plain arrays, selects instead of branches, so the
+ * compiler can vectorize it.
+ */
+static void scan(const htu21d_history_t *history, uint32_t from, uint32_t len, uint8_t flag_mask,
+                 uint8_t flag_value, scan_t *totals)
+{
+    const uint16_t *temperature = history->raw_temperature + from;
+    const uint16_t *humidity = history->raw_humidity + from;
+    const uint8_t *flags = history->flags + from;
+    scan_t t = *totals;
+
+    for (uint32_t i = 0; i < len; i++) {
+        bool keep = (flags[i] & flag_mask) == flag_value;
+        uint16_t value_t = temperature[i], value_rh = humidity[i];
+        t.count += keep;
+        t.sum_temperature += keep ? value_t : 0;
+        t.sum_humidity += keep ? value_rh : 0;
+        t.min_temperature = keep && value_t < t.min_temperature ? value_t : t.min_temperature;
+        t.max_temperature = keep && value_t > t.max_temperature ? value_t : t.max_temperature;
+        t.min_humidity = keep && value_rh < t.min_humidity ? value_rh : t.min_humidity;
+        t.max_humidity = keep && value_rh > t.max_humidity ? value_rh : t.max_humidity;
+    }
+    *totals = t;
+}
+
+/**
+ * @brief Prepares an empty history on caller provided columns of `capacity`
+ * entries each.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if a column is
+ * missing or the capacity is 0.
+ */
+int htu21d_history_init(htu21d_history_t *history, uint32_t capacity, uint64_t *timestamps_us,
+                        uint16_t *raw_temperature, uint16_t *raw_humidity, uint8_t *flags)
+{
+    if (history == NULL || capacity == 0 || timestamps_us == NULL || raw_temperature == NULL ||
+            raw_humidity == NULL || flags == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    *history = (htu21d_history_t) {
+        .timestamps_us = timestamps_us,
+        .raw_temperature = raw_temperature,
+        .raw_humidity = raw_humidity,
+        .flags = flags,
+        .capacity = capacity,
+        .start = 0,
+        .count = 0,
+    };
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Appends a sample, replacing the oldest one when the history is full.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if the sample is
+ * older than the newest one held (timestamps must not go backwards).
+ */
+int htu21d_history_push(htu21d_history_t *history, const htu21d_sample_t *sample)
+{
+    if (history->count > 0 &&
+            sample->timestamp_us < history->timestamps_us[column(history, history->count - 1)]) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+
+    uint32_t i;
+    if (history->count < history->capacity) {
+        i = column(history, history->count++);
+    } else {
+        i = history->start;
+        history->start = column(history, 1);
+    }
+    history->timestamps_us[i] = sample->timestamp_us;
+    history->raw_temperature[i] = sample->raw_temperature;
+    history->raw_humidity[i] = sample->raw_humidity;
+    history->flags[i] = sample->flags;
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Copies out sample `index` (0 = oldest), nothing converted yet.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if there is no
+ * such sample.
+ */
+int htu21d_history_get(const htu21d_history_t *history, uint32_t index, htu21d_sample_t *sample)
+{
+    if (index >= history->count) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    uint32_t i = column(history, index);
+    htu21d_sample_from_raw(sample, history->raw_temperature[i], history->raw_humidity[i],
+                           HTU21D_SAMPLE_RESOLUTION(history->flags[i]), history->flags[i],
+                           history->timestamps_us[i]);
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Finds the samples taken in `[from_us, to_us)` with two binary
+ * searches, O(log n).
+ * @param[out] count Number of samples in the range, 0 if none.
+ * @return Returns the index of the first sample in the range, for
+ * htu21d_history_get() and htu21d_history_stats().
+ */
+uint32_t htu21d_history_find(const htu21d_history_t *history, uint64_t from_us, uint64_t to_us,
+                             uint32_t *count)
+{
+    uint32_t first = lower_bound(history, from_us);
+    uint32_t end = to_us > from_us ? lower_bound(history, to_us) : first;
+
+    *count = end - first;
+    return first;
+}
+
+/**
+ * @brief Min, max and mean of samples `[first, first + count)`, counting only
+ * samples whose `flags & flag_mask` equal `flag_value` (pass `0, 0` for all).
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_NOTFOUND if no sample matched
+ * (`stats->count` is 0 then) or #HTU21D_ERR_INVALID_ARG if the window is out
+ * of range.
+ */
+int htu21d_history_stats(const htu21d_history_t *history, uint32_t first, uint32_t count,
+                         uint8_t flag_mask, uint8_t flag_value, htu21d_history_stats_t *stats)
+{
+    if (first > history->count || count > history->count - first) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    scan_t totals = {
+        .min_temperature = UINT16_MAX,
+        .min_humidity = UINT16_MAX,
+    };
+
+    // the window is at most two contiguous runs of the columns
+    uint32_t begin = column(history, first);
+    uint32_t run = history->capacity - begin < count ? history->capacity - begin : count;
+    scan(history, begin, run, flag_mask, flag_value, &totals);
+    scan(history, 0, count - run, flag_mask, flag_value, &totals);
+
+    *stats = (htu21d_history_stats_t) {
+        .count = totals.count,
+    };
+    if (totals.count == 0) {
+        return HTU21D_ERR_NOTFOUND;
+    }
+    stats->min_temperature = totals.min_temperature;
+    stats->max_temperature = totals.max_temperature;
+    stats->mean_temperature = (uint16_t)((totals.sum_temperature + totals.count / 2) / totals.count);
+    stats->min_humidity = totals.min_humidity;
+    stats->max_humidity = totals.max_humidity;
+    stats->mean_humidity = (uint16_t)((totals.sum_humidity + totals.count / 2) / totals.count);
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Picks `points` samples of a window that keep the shape of its plot,
+ * with Largest-Triangle-Three-Buckets.
+ *
+ * The first and last samples are kept and the rest of the window is split
+ * into `points - 2` buckets. From each bucket the sample forming the largest
+ * triangle with the previous pick and the average of the next bucket is
+ * kept, so peaks and dips survive where plain decimation would drop them.
+ *
+ * Runs in one pass over the window with constant state, on timestamps and
+ * raw codes in integer math: nothing is converted or copied, and only the
+ * picked samples need converting for display.
+ * @param first, count Window, e.g. from htu21d_history_find().
+ * @param values_column Values the triangles are measured on.
+ * @param[out] indices History indices of the picked samples, ascending, for
+ * htu21d_history_get().
+ * @param points Wanted number of samples, at least 3.
+ * @return Returns the number of indices written: `points`, the whole window
+ * if it is not larger, or 0 if the window is out of range or `points` < 3.
+ */
+uint32_t htu21d_history_downsample(const htu21d_history_t *history, uint32_t first, uint32_t count,
+                                   htu21d_history_column_t values_column, uint32_t *indices, uint32_t points)
+{
+    const uint16_t *values = values_column == HTU21D_HISTORY_HUMIDITY ? history->raw_humidity
+                              : history->raw_temperature;
+
+    if (points < 3 || first > history->count || count > history->count - first) {
+        return 0;
+    }
+    if (count <= points) {
+        for (uint32_t i = 0; i < count; i++) {
+            indices[i] = first + i;
+        }
+        return count;
+    }
+
+    // x relative to the window start keeps the products within 64 bits
+    uint64_t origin_us = history->timestamps_us[column(history, first)];
+    uint32_t buckets = points - 2;
+    uint32_t picked = 0, written = 0;
+
+    indices[written++] = first;
+    for (uint32_t b = 0; b < buckets; b++) {
+        uint32_t begin = 1 + (uint32_t)((uint64_t) b * (count - 2) / buckets);
+        uint32_t end = 1 + (uint32_t)((uint64_t)(b + 1) * (count - 2) / buckets);
+        uint32_t next_end = b + 1 < buckets ? 1 + (uint32_t)((uint64_t)(b + 2) * (count - 2) / buckets) : count;
+
+        // the third corner: average of the next bucket (the last sample after the last bucket)
+        uint64_t sum_x = 0, sum_y = 0;
+        for (uint32_t i = end; i < next_end; i++) {
+            uint32_t c = column(history, first + i);
+            sum_x += history->timestamps_us[c] - origin_us;
+            sum_y += values[c];
+        }
+        int64_t cx = (int64_t)(sum_x / (next_end - end));
+        int64_t cy = (int64_t)(sum_y / (next_end - end));
+
+        uint32_t a = column(history, first + picked);
+        int64_t ax = (int64_t)(history->timestamps_us[a] - origin_us);
+        int64_t ay = values[a];
+        uint64_t largest = 0;
+        uint32_t pick = begin;
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t c = column(history, first + i);
+            int64_t bx = (int64_t)(history->timestamps_us[c] - origin_us);
+            int64_t area = (ax - cx) * (values[c] - ay) - (ax - bx) * (cy - ay);
+            uint64_t doubled = (uint64_t)(area < 0 ? -area : area);
+            if (doubled > largest) {
+                largest = doubled;
+                pick = i;
+            }
+        }
+        picked = pick;
+        indices[written++] = first + picked;
+    }
+    indices[written++] = first + count - 1;
+    return written;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file htu21d_history.h
+ * @brief Fixed-capacity in-RAM history of recent samples, stored by column.
+ *
+ * Samples are kept as separate arrays of timestamps, raw temperature, raw
+ * humidity and flags (struct of arrays), 13 bytes per sample instead of a
+ * struct of floats. Time range queries are a binary search on the timestamp
+ * column, and min/max/mean scans walk one `uint16_t` column in at most two
+ * contiguous runs with no branches in the loop, which compilers vectorize.
+ * Everything stays in raw codes until the caller converts the few results,
+ * including htu21d_history_downsample(), which thins a window down to the
+ * points a small display can show.
+ *
+ * When full, the history overwrites its oldest sample. The caller provides
+ * the column arrays, so the history never allocates.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_HISTORY_H__
+#define __HTU21D_HISTORY_H__
+
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief History state and its columns, `capacity` entries each.
+ */
+typedef struct {
+    uint64_t *timestamps_us;      /**< htu21d_sample_t::timestamp_us, ascending. */
+    uint16_t *raw_temperature;    /**< htu21d_sample_t::raw_temperature. */
+    uint16_t *raw_humidity;       /**< htu21d_sample_t::raw_humidity. */
+    uint8_t *flags;               /**< htu21d_sample_t::flags. */
+    uint32_t capacity;            /**< Entries per column. */
+    uint32_t start;               /**< Column index of the oldest sample. */
+    uint32_t count;               /**< Samples held. */
+} htu21d_history_t;
+
+/**
+ * @brief A value column of the history.
+ */
+typedef enum {
+    HTU21D_HISTORY_TEMPERATURE,   /**< htu21d_history_t::raw_temperature. */
+    HTU21D_HISTORY_HUMIDITY,      /**< htu21d_history_t::raw_humidity. */
+} htu21d_history_column_t;
+
+/**
+ * @brief Result of htu21d_history_stats(), in raw codes.
+ *
+ * The conversion formulas are linear, so htu21d_raw_to_temperature() and
+ * htu21d_raw_to_humidity() of these give the min/max/mean in degC and %RH.
+ */
+typedef struct {
+    uint32_t count;               /**< Samples that matched the flag filter. */
+    uint16_t min_temperature;
+    uint16_t max_temperature;
+    uint16_t mean_temperature;
+    uint16_t min_humidity;
+    uint16_t max_humidity;
+    uint16_t mean_humidity;
+} htu21d_history_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_history_init(htu21d_history_t *history, uint32_t capacity, uint64_t *timestamps_us,
+                        uint16_t *raw_temperature, uint16_t *raw_humidity, uint8_t *flags);
+int htu21d_history_push(htu21d_history_t *history, const htu21d_sample_t *sample);
+int htu21d_history_get(const htu21d_history_t *history, uint32_t index, htu21d_sample_t *sample);
+uint32_t htu21d_history_find(const htu21d_history_t *history, uint64_t from_us, uint64_t to_us,
+                             uint32_t *count);
+int htu21d_history_stats(const htu21d_history_t *history, uint32_t first, uint32_t count,
+                         uint8_t flag_mask, uint8_t flag_value, htu21d_history_stats_t *stats);
+uint32_t htu21d_history_downsample(const htu21d_history_t *history, uint32_t first, uint32_t count,
+                                   htu21d_history_column_t values_column, uint32_t *indices, uint32_t points);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_HISTORY_H__
@@ -0,0 +1,146 @@
+/**
+ * @file htu21d_kalman.c
+ * @brief Fixed-point Kalman filter smoothing temperature and humidity
+ * together.
+ *
+ * With the state `x = (T, RH)`, both channels measured directly (`H = I`)
+ * and a random walk (`F = I`), one step is:
+ *
+ *     P = P + Q                         predict
+ *     S = P + R
+ *     K = P * inverse(S)                2x2, by the adjugate over det(S)
+ *     x = x + K * (z - x)               update
+ *     P = P - K * P
+ *
+ * Values are thousandths of a unit in `int32_t`, variances their squares and
+ * gains Q16. With every noise at most #HTU21D_KALMAN_MAX_NOISE, variances stay
+ * below 2^23 and every product below 2^63.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stddef.h>
+#include "htu21d_kalman.h"
+
+#define GAIN_ONE        65536     /**< 1.0 as a Q16 gain. */
+#define MAX_COVARIANCE  (1 << 21) /**< Prediction growth stops here while samples fail. */
+
+/**
+ * @brief Index of resolution bits into htu21d_kalman_t::measurement.
+ */
+static int resolution_index(uint8_t resolution)
+{
+    return ((resolution >> 6) & 0x02) | (resolution & 0x01);
+}
+
+/**
+ * @brief Q16 product, rounded.
+ */
+static int64_t mul_gain(int64_t gain, int64_t value)
+{
+    return (gain * value + GAIN_ONE / 2) >> 16;
+}
+
+static int32_t variance(float sigma, uint8_t oversampling)
+{
+    float milli = sigma * 1000.0F;
+    return (int32_t)(milli * milli / (oversampling > 1 ? oversampling : 1) + 0.5F);
+}
+
+/**
+ * @brief Prepares a filter. It starts from the first good sample passed to
+ * htu21d_kalman_update().
+ * @param config Drift between samples and the samples' oversampling.
+ * @param noise Single conversion noise of the four resolutions as for
+ * htu21d_plan(), or `NULL` for datasheet figures.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if a drift or
+ * noise is not within (0, #HTU21D_KALMAN_MAX_NOISE], the correlation not
+ * within (-1, 1) or `noise` misses a resolution.
+ */
+int htu21d_kalman_init(htu21d_kalman_t *filter, const htu21d_kalman_config_t *config,
+                       const htu21d_noise_t noise[HTU21D_RESOLUTIONS])
+{
+    if (filter == NULL || config == NULL ||
+            !(config->temperature_drift > 0 && config->temperature_drift <= HTU21D_KALMAN_MAX_NOISE) ||
+            !(config->humidity_drift > 0 && config->humidity_drift <= HTU21D_KALMAN_MAX_NOISE) ||
+            !(config->drift_correlation > -1 && config->drift_correlation < 1)) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+
+    *filter = (htu21d_kalman_t) {
+        .initialized = false,
+    };
+    filter->process[0] = variance(config->temperature_drift, 1);
+    filter->process[2] = variance(config->humidity_drift, 1);
+    filter->process[1] = (int32_t)(config->drift_correlation * config->temperature_drift *
+                                   config->humidity_drift * 1000000.0F);
+
+    static const uint8_t resolutions[HTU21D_RESOLUTIONS] = {0x00, 0x01, 0x80, 0x81};
+    for (int r = 0; r < HTU21D_RESOLUTIONS; r++) {
+        htu21d_noise_t single;
+        if (htu21d_resolution_noise(resolutions[r], noise, &single) != HTU21D_ERR_OK ||
+                !(single.temperature > 0 && single.temperature <= HTU21D_KALMAN_MAX_NOISE) ||
+                !(single.humidity > 0 && single.humidity <= HTU21D_KALMAN_MAX_NOISE)) {
+            return HTU21D_ERR_INVALID_ARG;
+        }
+        int i = resolution_index(resolutions[r]);
+        filter->measurement[i][0] = variance(single.temperature, config->temperature_oversampling);
+        filter->measurement[i][1] = variance(single.humidity, config->humidity_oversampling);
+    }
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Folds a sample into the estimates.
+ *
+ * A sample without #HTU21D_SAMPLE_CRC_OK only advances the prediction, so
+ * the next good sample is trusted a little more.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_CRC if the sample was not
+ * used (the estimates are unchanged).
+ */
+int htu21d_kalman_update(htu21d_kalman_t *filter, const htu21d_sample_t *sample)
+{
+    int32_t *p = filter->covariance;
+    const int32_t *q = filter->process;
+    const int32_t *r = filter->measurement[resolution_index(sample->resolution)];
+
+    if (!(sample->flags & HTU21D_SAMPLE_CRC_OK)) {
+        if (filter->initialized && p[0] < MAX_COVARIANCE && p[2] < MAX_COVARIANCE) {
+            p[0] += q[0];
+            p[1] += q[1];
+            p[2] += q[2];
+        }
+        return HTU21D_ERR_CRC;
+    }
+
+    // the conversion formulas of the datasheet, in thousandths
+    int32_t z_t = -46850 + (int32_t)(((int64_t) 175720 * sample->raw_temperature) >> 16);
+    int32_t z_rh = -6000 + (int32_t)(((int64_t) 125000 * sample->raw_humidity) >> 16);
+    if (!filter->initialized) {
+        filter->temperature = z_t;
+        filter->humidity = z_rh;
+        p[0] = r[0];
+        p[1] = 0;
+        p[2] = r[1];
+        filter->initialized = true;
+        return HTU21D_ERR_OK;
+    }
+
+    int64_t p00 = p[0] + q[0], p01 = p[1] + q[1], p11 = p[2] + q[2];
+    int64_t s00 = p00 + r[0], s11 = p11 + r[1];
+    int64_t det = s00 * s11 - p01 * p01;
+
+    int64_t k00 = (p00 * s11 - p01 * p01) * GAIN_ONE / det;
+    int64_t k01 = (p01 * s00 - p00 * p01) * GAIN_ONE / det;
+    int64_t k10 = (p01 * s11 - p11 * p01) * GAIN_ONE / det;
+    int64_t k11 = (p11 * s00 - p01 * p01) * GAIN_ONE / det;
+
+    int64_t d_t = z_t - filter->temperature, d_rh = z_rh - filter->humidity;
+    filter->temperature += (int32_t) mul_gain(k00, d_t) + (int32_t) mul_gain(k01, d_rh);
+    filter->humidity += (int32_t) mul_gain(k10, d_t) + (int32_t) mul_gain(k11, d_rh);
+
+    p[0] = (int32_t)(p00 - mul_gain(k00, p00) - mul_gain(k01, p01));
+    p[1] = (int32_t)(p01 - mul_gain(k00, p01) - mul_gain(k01, p11));
+    p[2] = (int32_t)(p11 - mul_gain(k10, p01) - mul_gain(k11, p11));
+    return HTU21D_ERR_OK;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file htu21d_kalman.h
+ * @brief Fixed-point Kalman filter smoothing temperature and humidity
+ * together.
+ *
+ * The state is the true temperature and humidity, modeled as a random walk
+ * whose steps may be correlated (air warming up usually means falling
+ * relative humidity), so a change seen on one channel also moves the other
+ * estimate. The measurement noise of each sample follows the resolution it
+ * was measured at (htu21d_sample_t::resolution, as set with
+ * htu21d_set_resolution() and read back with htu21d_get_resolution()), so a
+ * fast, noisy resolution gets smoothed harder than a slow, quiet one.
+ *
+ * Each update is straight-line integer code: no floats, no loops and a fixed
+ * sequence of 32/64-bit multiplies and four 64-bit divisions. Floats are
+ * only used once, to set the filter up.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_KALMAN_H__
+#define __HTU21D_KALMAN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+#define HTU21D_KALMAN_MAX_NOISE 1.0F /**< Largest drift and conversion noise, degC or %RH, keeping the math within 64 bits. */
+
+/**
+ * @brief How the true values move between samples, and how the samples were
+ * taken.
+ */
+typedef struct {
+    float temperature_drift;      /**< Typical change of the temperature from one sample to the next (std. dev.), degC. */
+    float humidity_drift;         /**< Typical change of the humidity from one sample to the next (std. dev.), %RH. */
+    float drift_correlation;      /**< Correlation of the two changes, above -1 and below 1. */
+    uint8_t temperature_oversampling; /**< htu21d_dev_t::temperature_oversampling of the samples (0 counts as 1). */
+    uint8_t humidity_oversampling;    /**< htu21d_dev_t::humidity_oversampling of the samples (0 counts as 1). */
+} htu21d_kalman_config_t;
+
+/**
+ * @brief Filter state. Values are in thousandths of a degC or %RH.
+ */
+typedef struct {
+    int32_t temperature;          /**< Temperature estimate, mdegC. */
+    int32_t humidity;             /**< Humidity estimate, m%RH. */
+    int32_t covariance[3];        /**< Estimate covariance: temperature, cross term, humidity. */
+    int32_t process[3];           /**< Drift covariance per sample, same layout. */
+    int32_t measurement[HTU21D_RESOLUTIONS][2]; /**< Temperature and humidity noise variance per resolution. */
+    bool initialized;             /**< False until the first good sample. */
+} htu21d_kalman_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_kalman_init(htu21d_kalman_t *filter, const htu21d_kalman_config_t *config,
+                       const htu21d_noise_t noise[HTU21D_RESOLUTIONS]);
+int htu21d_kalman_update(htu21d_kalman_t *filter, const htu21d_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_KALMAN_H__
@@ -0,0 +1,135 @@
+/**
+ * @file htu21d_mold.c
+ * @brief Mold growth index (VTT model), updated per reading.
+ *
+ * While `0 < T < 50 degC` and `RH >= RH_crit(T)` the index grows by
+ *
+ *     dM/dt = k1 * k2 / (7 * exp(-0.68 ln T - 13.9 ln RH + 66.02))    per day
+ *
+ * (pine, sawn surface), with `k1` the material's growth factor and
+ * `k2 = max(0, 1 - exp(2.3 * (M - M_max)))` limiting M to what the humidity
+ * can sustain. Otherwise it declines by `decline * 0.00133` per hour for the
+ * first 6 hours, not at all up to 24 hours and by `decline * 0.000667` per
+ * hour after that.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include "htu21d_mold.h"
+
+#if CONFIG_HTU21D_DERIVED_MATH
+
+#define HTU21D_MOLD_MAX_INDEX   6.0F
+
+/**
+ * @brief Material parameters of a sensitivity class (Ojanen et al. 2010).
+ */
+typedef struct {
+    float k1_initial;     /**< Growth factor while M < 1. */
+    float k1_visible;     /**< Growth factor once M >= 1. */
+    float a, b, c;        /**< M_max = A + B * x - C * x^2, x = (RH_crit - RH) / (RH_crit - 100). */
+    float rh_min;         /**< Lowest critical humidity, %RH. */
+} mold_class_t;
+
+static const mold_class_t _classes[] = {
+    [HTU21D_MOLD_VERY_SENSITIVE] = {1.0F, 2.0F, 1.0F, 7.0F, 2.0F, 80.0F},
+    [HTU21D_MOLD_SENSITIVE] = {0.578F, 0.386F, 0.3F, 6.0F, 1.0F, 80.0F},
+    [HTU21D_MOLD_MEDIUM_RESISTANT] = {0.072F, 0.097F, 0.0F, 5.0F, 1.5F, 85.0F},
+    [HTU21D_MOLD_RESISTANT] = {0.033F, 0.014F, 0.0F, 3.0F, 1.0F, 85.0F},
+};
+
+/**
+ * @brief Humidity above which mold grows at `temperature`, %RH.
+ */
+static float critical_humidity(const mold_class_t *material, float temperature)
+{
+    float rh = 80.0F;
+
+    if (temperature <= 20.0F) {
+        rh = ((-0.00267F * temperature + 0.160F) * temperature - 3.13F) * temperature + 100.0F;
+    }
+    return rh > material->rh_min ? rh : material->rh_min;
+}
+
+/**
+ * @brief Hours of `[from, to)` that overlap `[begin, end)`.
+ */
+static float overlap_h(uint32_t from_s, uint32_t to_s, uint32_t begin_s, uint32_t end_s)
+{
+    uint32_t low = from_s > begin_s ? from_s : begin_s;
+    uint32_t high = to_s < end_s ? to_s : end_s;
+
+    return high > low ? (high - low) / 3600.0F : 0.0F;
+}
+
+/**
+ * @brief Prepares a model with no growth yet.
+ * @param decline Decline factor of the material in dry periods: 1 for pine
+ * (the original model), down to 0.1 for materials where growth stays.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG for an unknown
+ * class or a decline factor outside (0, 1].
+ */
+int htu21d_mold_init(htu21d_mold_t *mold, htu21d_mold_sensitivity_t sensitivity, float decline)
+{
+    if (mold == NULL || sensitivity < HTU21D_MOLD_VERY_SENSITIVE || sensitivity > HTU21D_MOLD_RESISTANT ||
+            !(decline > 0 && decline <= 1)) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    *mold = (htu21d_mold_t) {
+        .index = 0,
+        .decline = decline,
+        .unfavorable_s = 0,
+        .sensitivity = (uint8_t) sensitivity,
+    };
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Advances the model by `elapsed_s` at the given conditions, e.g. the
+ * outputs of htu21d_read_temperature() and htu21d_read_humidity() and the
+ * time since the previous update.
+ *
+ * Conditions are taken as constant over the step, so keep steps at most an
+ * hour or so while growth conditions hold.
+ * @param relative_humidity %RH, values above 100 count as 100.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG for a model not
+ * set up with htu21d_mold_init(), a failed reading (-999) or values outside
+ * the sensor's range (the state is left unchanged then).
+ */
+int htu21d_mold_update(htu21d_mold_t *mold, float temperature, float relative_humidity, uint32_t elapsed_s)
+{
+    if (mold == NULL || mold->sensitivity > HTU21D_MOLD_RESISTANT ||
+            !(temperature >= -40.0F && temperature <= 125.0F) || !(relative_humidity >= 0.0F)) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    const mold_class_t *material = &_classes[mold->sensitivity];
+    float rh = relative_humidity < 100.0F ? relative_humidity : 100.0F;
+    float rh_crit = critical_humidity(material, temperature);
+
+    if (temperature > 0.0F && temperature < 50.0F && rh >= rh_crit) {
+        float x = (rh_crit - rh) / (rh_crit - 100.0F);
+        float m_max = material->a + material->b * x - material->c * x * x;
+        float k1 = mold->index < 1.0F ? material->k1_initial : material->k1_visible;
+        float k2 = 1.0F - expf(2.3F * (mold->index - m_max));
+        if (k2 > 0) {
+            float per_day = k1 * k2 / (7.0F * expf(-0.68F * logf(temperature) - 13.9F * logf(rh) + 66.02F));
+            mold->index += per_day * elapsed_s / 86400.0F;
+        }
+        mold->index = mold->index < HTU21D_MOLD_MAX_INDEX ? mold->index : HTU21D_MOLD_MAX_INDEX;
+        mold->unfavorable_s = 0;
+        return HTU21D_ERR_OK;
+    }
+
+    uint32_t from_s = mold->unfavorable_s;
+    uint32_t to_s = UINT32_MAX - from_s > elapsed_s ? from_s + elapsed_s : UINT32_MAX;
+    float drop = 0.00133F * overlap_h(from_s, to_s, 0, 6 * 3600) +
+                 0.000667F * overlap_h(from_s, to_s, 24 * 3600, UINT32_MAX);
+    mold->index -= mold->decline * drop;
+    mold->index = mold->index > 0.0F ? mold->index : 0.0F;
+    mold->unfavorable_s = to_s;
+    return HTU21D_ERR_OK;
+}
+
+#endif  // CONFIG_HTU21D_DERIVED_MATH
@@ -0,0 +1,69 @@
+/**
+ * @file htu21d_mold.h
+ * @brief Mold growth index (VTT model), updated per reading.
+ *
+ * Implements the VTT mold growth model (Hukka & Viitanen 1999, with the
+ * material classes of Ojanen et al. 2010): the mold index M rises while the
+ * surface is warm and humid enough and slowly declines in dry periods. Each
+ * update costs O(1) and the whole state is 16 bytes, so it can live in RTC
+ * memory across deep sleep:
+ *
+ *     RTC_DATA_ATTR static htu21d_mold_t mold;
+ *
+ * Elapsed time is passed in by the caller instead of being read from a
+ * clock, because the system clock restarts after deep sleep.
+ *
+ * | M | Meaning                                      |
+ * |---|----------------------------------------------|
+ * | 0 | No growth                                    |
+ * | 1 | Some growth visible under a microscope       |
+ * | 3 | Growth visible to the naked eye              |
+ * | 6 | Heavy, tight growth, 100 % coverage          |
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_MOLD_H__
+#define __HTU21D_MOLD_H__
+
+#include <stdint.h>
+#include "htu21d.h"
+
+#if CONFIG_HTU21D_DERIVED_MATH
+
+/**
+ * @brief Mold sensitivity classes of Ojanen et al. 2010.
+ */
+typedef enum {
+    HTU21D_MOLD_VERY_SENSITIVE = 0,   /**< Untreated wood, pine sapwood (the original model). */
+    HTU21D_MOLD_SENSITIVE,            /**< Glued wooden boards, paper coated products, spruce. */
+    HTU21D_MOLD_MEDIUM_RESISTANT,     /**< Cement and plastic based materials, mineral fibers. */
+    HTU21D_MOLD_RESISTANT,            /**< Glass, metals, materials with strong fungicides. */
+} htu21d_mold_sensitivity_t;
+
+/**
+ * @brief Model state.
+ */
+typedef struct {
+    float index;                  /**< Mold index M, 0-6. */
+    float decline;                /**< Decline factor of the material (1 for pine, 0.5, 0.25 or 0.1 for slower ones). */
+    uint32_t unfavorable_s;       /**< Time since growth conditions ended, 0 while they hold. */
+    uint8_t sensitivity;          /**< htu21d_mold_sensitivity_t. */
+} htu21d_mold_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_mold_init(htu21d_mold_t *mold, htu21d_mold_sensitivity_t sensitivity, float decline);
+int htu21d_mold_update(htu21d_mold_t *mold, float temperature, float relative_humidity, uint32_t elapsed_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CONFIG_HTU21D_DERIVED_MATH
+
+#endif  // __HTU21D_MOLD_H__
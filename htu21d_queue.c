@@ -0,0 +1,104 @@
+/**
+ * @file htu21d_queue.c
+ * @brief Bounded lock-free multi-producer/single-consumer queue of samples.
+ *
+ * Array of slots indexed by a free running position modulo the (power of
+ * two) capacity. Slot `i` starts with sequence `i`:
+ *
+ * - a producer at position `p` may fill the slot when its sequence is `p`,
+ *   claims `p` by advancing the head with a compare-and-swap, copies the
+ *   record and publishes it by setting the sequence to `p + 1`
+ * - the consumer at position `t` may read the slot when its sequence is
+ *   `t + 1`, and hands it back to producers of the next lap by setting it to
+ *   `t + capacity`
+ *
+ * A sequence behind the producer's position means the slot still holds a
+ * record from the previous lap: the queue is full.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stddef.h>
+#include "htu21d_queue.h"
+
+/**
+ * @brief Prepares a queue on caller provided slots.
+ * @param capacity Number of slots, a power of two.
+ * @return Returns #HTU21D_ERR_OK, or #HTU21D_ERR_INVALID_ARG if the capacity
+ * is not a power of two.
+ */
+int htu21d_queue_init(htu21d_queue_t *queue, htu21d_queue_slot_t *slots, uint32_t capacity)
+{
+    if (queue == NULL || slots == NULL || capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        __atomic_store_n(&slots[i].sequence, i, __ATOMIC_RELAXED);
+    }
+    queue->slots = slots;
+    queue->mask = capacity - 1;
+    queue->tail = 0;
+    __atomic_store_n(&queue->overflows, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&queue->head, 0, __ATOMIC_RELEASE);
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Adds a record, from any number of tasks at once.
+ * @return Returns `true`, or `false` (and counts an overflow) if the queue is
+ * full.
+ */
+bool htu21d_queue_push(htu21d_queue_t *queue, const htu21d_record_t *record)
+{
+    uint32_t position = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    htu21d_queue_slot_t *slot;
+
+    for (;;) {
+        slot = &queue->slots[position & queue->mask];
+        int32_t lag = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+        if (lag == 0) {
+            // free for this lap, claim it
+            if (__atomic_compare_exchange_n(&queue->head, &position, position + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (lag < 0) {
+            __atomic_fetch_add(&queue->overflows, 1, __ATOMIC_RELAXED);
+            return false;
+        } else {
+            // another producer got here first
+            position = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->record = *record;
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Takes the oldest record, from the one consumer task only.
+ * @return Returns `true` with a record, or `false` if the queue is empty (or
+ * the oldest record is still being written).
+ */
+bool htu21d_queue_pop(htu21d_queue_t *queue, htu21d_record_t *record)
+{
+    uint32_t position = queue->tail;
+    htu21d_queue_slot_t *slot = &queue->slots[position & queue->mask];
+
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1) {
+        return false;
+    }
+    *record = slot->record;
+    __atomic_store_n(&slot->sequence, position + queue->mask + 1, __ATOMIC_RELEASE);
+    queue->tail = position + 1;
+    return true;
+}
+
+/**
+ * @brief Records dropped by htu21d_queue_push() because the queue was full.
+ */
+uint32_t htu21d_queue_overflows(const htu21d_queue_t *queue)
+{
+    return __atomic_load_n(&queue->overflows, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file htu21d_queue.h
+ * @brief Bounded lock-free multi-producer/single-consumer queue of samples.
+ *
+ * Lets any number of sampling tasks (or ISRs) hand fixed-size sample records
+ * to one storage or uplink task without a mutex: producers claim a slot with
+ * a compare-and-swap on the head, the consumer owns the tail. Every slot
+ * carries a sequence number that tells whose turn it is, so a producer that
+ * is preempted half way through a push only delays the consumer at that slot
+ * and never blocks other producers.
+ *
+ * The queue never allocates; the caller provides the slots. When it is full a
+ * push fails right away and counts an overflow, it never waits.
+ *
+ * Built on the GCC/Clang `__atomic` builtins (as used by ESP-IDF's toolchain),
+ * so this header stays includable from C++.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_QUEUE_H__
+#define __HTU21D_QUEUE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief A sample and the sensor it came from.
+ */
+typedef struct {
+    uint16_t source;              /**< Caller chosen sensor id. */
+    htu21d_sample_t sample;       /**< The reading. */
+} htu21d_record_t;
+
+/**
+ * @brief One queue entry, provide an array of them to htu21d_queue_init().
+ */
+typedef struct {
+    uint32_t sequence;            /**< Position this slot is ready for, see htu21d_queue.c. */
+    htu21d_record_t record;       /**< Payload. */
+} htu21d_queue_slot_t;
+
+/**
+ * @brief Queue state, treat as opaque.
+ */
+typedef struct {
+    htu21d_queue_slot_t *slots;
+    uint32_t mask;                /**< Capacity - 1. */
+    uint32_t head;                /**< Next position to push, shared by producers. */
+    uint32_t tail;                /**< Next position to pop, consumer only. */
+    uint32_t overflows;           /**< Records dropped because the queue was full. */
+} htu21d_queue_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_queue_init(htu21d_queue_t *queue, htu21d_queue_slot_t *slots, uint32_t capacity);
+bool htu21d_queue_push(htu21d_queue_t *queue, const htu21d_record_t *record);
+bool htu21d_queue_pop(htu21d_queue_t *queue, htu21d_record_t *record);
+uint32_t htu21d_queue_overflows(const htu21d_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_QUEUE_H__
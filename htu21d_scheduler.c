@@ -0,0 +1,156 @@
+/**
+ * @file htu21d_scheduler.c
+ * @brief Temperature and humidity measured at their own rates and
+ * resolutions, delivered as one timeline.
+ *
+ * Conversions go through htu21d_dev_measure(), one at a time since the
+ * sensor converts one channel at a time.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stddef.h>
+#include "htu21d_scheduler.h"
+#include "htu21d_port.h"
+
+#define HTU21D_SCHEDULER_KEEP_BITS  0x7E /**< User register bits other than the resolution. */
+
+static const uint8_t _commands[HTU21D_CHANNELS] = {
+    [HTU21D_CHANNEL_TEMPERATURE] = TRIGGER_TEMP_MEASURE_NOHOLD,
+    [HTU21D_CHANNEL_HUMIDITY] = TRIGGER_HUMD_MEASURE_NOHOLD,
+};
+
+/**
+ * @brief Picks the channel to measure next: of those already due the one
+ * at the current resolution setting, else the earliest due.
+ * @return Returns the channel, or -1 if all are off.
+ */
+static int pick(const htu21d_scheduler_t *scheduler, uint64_t now_us)
+{
+    int next = -1;
+
+    for (int channel = 0; channel < HTU21D_CHANNELS; channel++) {
+        if (scheduler->channels[channel].period_ms == 0) {
+            continue;
+        }
+        if (next < 0) {
+            next = channel;
+            continue;
+        }
+        bool due = scheduler->due_us[channel] <= now_us && scheduler->due_us[next] <= now_us;
+        bool matches = scheduler->channels[channel].resolution == scheduler->dev->resolution;
+        bool next_matches = scheduler->channels[next].resolution == scheduler->dev->resolution;
+        if (due && matches != next_matches) {
+            next = matches ? channel : next;
+        } else if (scheduler->due_us[channel] < scheduler->due_us[next]) {
+            next = channel;
+        }
+    }
+    return next;
+}
+
+/**
+ * @brief Prepares a schedule with every channel due right away.
+ *
+ * Reads the user register, so resolution switches keep the heater and
+ * reserved bits the chip really has and skip only writes that are really
+ * not needed.
+ * @param channels Period and resolution per htu21d_channel_t.
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_INVALID_ARG for a resolution
+ * with other bits than 0x81 set, or the error of the register read.
+ */
+int htu21d_scheduler_init(htu21d_scheduler_t *scheduler, htu21d_dev_t *dev,
+                          const htu21d_channel_config_t channels[HTU21D_CHANNELS])
+{
+    if (scheduler == NULL || dev == NULL || channels == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    for (int channel = 0; channel < HTU21D_CHANNELS; channel++) {
+        if (channels[channel].resolution & HTU21D_SCHEDULER_KEEP_BITS) {
+            return HTU21D_ERR_INVALID_ARG;
+        }
+    }
+    int ret = htu21d_dev_load_user_register(dev);
+    if (ret != HTU21D_ERR_OK) {
+        return ret;
+    }
+    uint64_t now_us = htu21d_port_time_us();
+    for (int channel = 0; channel < HTU21D_CHANNELS; channel++) {
+        scheduler->channels[channel] = channels[channel];
+        scheduler->due_us[channel] = now_us;
+    }
+    scheduler->dev = dev;
+    scheduler->overruns = 0;
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Waits for the next due conversion, runs it and returns its reading.
+ *
+ * A reading that failed its CRC check is returned with
+ * #HTU21D_SAMPLE_CRC_OK cleared. If the sensor falls behind by a whole period
+ * the missed slots are skipped and counted in htu21d_scheduler_t::overruns.
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_INVALID_STATE if both channels
+ * are off, or the error that stopped the measurement (the slot is skipped).
+ */
+int htu21d_scheduler_next(htu21d_scheduler_t *scheduler, htu21d_reading_t *reading)
+{
+    if (scheduler == NULL || reading == NULL) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    htu21d_dev_t *dev = scheduler->dev;
+    uint64_t now_us = htu21d_port_time_us();
+    int channel = pick(scheduler, now_us);
+    if (channel < 0) {
+        return HTU21D_ERR_INVALID_STATE;
+    }
+    if (scheduler->due_us[channel] > now_us) {
+        htu21d_port_delay_ms((uint32_t)((scheduler->due_us[channel] - now_us + 999) / 1000));
+    }
+
+    const htu21d_channel_config_t *config = &scheduler->channels[channel];
+    uint8_t command = _commands[channel];
+    uint16_t raw = 0;
+    int ret = HTU21D_ERR_OK;
+    if (dev->resolution != config->resolution) {
+        ret = htu21d_dev_write_user_register(dev, (dev->user_register & HTU21D_SCHEDULER_KEEP_BITS) |
+                                             config->resolution);
+    }
+    uint64_t timestamp_us = htu21d_port_time_us();
+    if (ret == HTU21D_ERR_OK) {
+        ret = htu21d_dev_measure(dev, command, &raw);
+    }
+
+    // next slot on the grid, skipping those already missed
+    uint64_t period_us = config->period_ms * 1000ULL;
+    now_us = htu21d_port_time_us();
+    scheduler->due_us[channel] += period_us;
+    if (scheduler->due_us[channel] < now_us) {
+        uint64_t missed = (now_us - scheduler->due_us[channel] + period_us - 1) / period_us;
+        scheduler->overruns += (uint32_t) missed;
+        scheduler->due_us[channel] += missed * period_us;
+    }
+
+    if (ret != HTU21D_ERR_OK && ret != HTU21D_ERR_CRC) {
+        return ret;
+    }
+    *reading = (htu21d_reading_t) {
+        .timestamp_us = timestamp_us,
+        .raw = raw,
+        .channel = (uint8_t) channel,
+        .resolution = config->resolution,
+        .flags = ret == HTU21D_ERR_OK ? HTU21D_SAMPLE_CRC_OK : 0,
+    };
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Converts a reading to degC or %RH, by its channel.
+ */
+float htu21d_reading_value(const htu21d_reading_t *reading)
+{
+    if (reading->channel == HTU21D_CHANNEL_TEMPERATURE) {
+        return htu21d_raw_to_temperature(reading->raw);
+    }
+    return htu21d_raw_to_humidity(reading->raw);
+}
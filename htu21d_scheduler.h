@@ -0,0 +1,81 @@
+/**
+ * @file htu21d_scheduler.h
+ * @brief Temperature and humidity measured at their own rates and
+ * resolutions, delivered as one timeline.
+ *
+ * Each channel has a period and the user register resolution setting it is
+ * measured at, e.g. temperature every 100 ms at 11 bits and humidity every
+ * 30 s at 12 bits. Conversions run earliest due first on fixed period grids,
+ * so a late conversion doesn't shift the ones after it. Among due
+ * conversions the one matching the current resolution setting goes first, so
+ * the user register is only written when the setting really changes. A
+ * channel with period 0 is never measured.
+ *
+ * Every call of htu21d_scheduler_next() waits for and returns the next
+ * reading of either channel, in time order. Conversions follow the device's
+ * htu21d_dev_t::read_mode and its circuit breaker like the other reads, but
+ * are single conversions: the device's oversampling is not applied.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_SCHEDULER_H__
+#define __HTU21D_SCHEDULER_H__
+
+#include <stdint.h>
+#include "htu21d.h"
+
+/**
+ * @brief A measured quantity.
+ */
+typedef enum {
+    HTU21D_CHANNEL_TEMPERATURE,
+    HTU21D_CHANNEL_HUMIDITY,
+    HTU21D_CHANNELS,
+} htu21d_channel_t;
+
+/**
+ * @brief Rate and resolution of one channel.
+ */
+typedef struct {
+    uint32_t period_ms;           /**< Time between readings, 0 turns the channel off. */
+    uint8_t resolution;           /**< Resolution bits of the user register the channel is measured at. */
+} htu21d_channel_config_t;
+
+/**
+ * @brief One reading of one channel.
+ */
+typedef struct {
+    uint64_t timestamp_us;        /**< Start of the conversion, see htu21d_port_time_us(). */
+    uint16_t raw;                 /**< Raw code with the status bits cleared. */
+    uint8_t channel;              /**< htu21d_channel_t. */
+    uint8_t resolution;           /**< Resolution bits it was measured at. */
+    uint8_t flags;                /**< #HTU21D_SAMPLE_CRC_OK if the CRC matched. */
+} htu21d_reading_t;
+
+/**
+ * @brief Scheduler state, treat as opaque.
+ */
+typedef struct {
+    htu21d_dev_t *dev;
+    htu21d_channel_config_t channels[HTU21D_CHANNELS];
+    uint64_t due_us[HTU21D_CHANNELS]; /**< Slot of the next reading per channel. */
+    uint32_t overruns;            /**< Slots skipped because the sensor couldn't keep up. */
+} htu21d_scheduler_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_scheduler_init(htu21d_scheduler_t *scheduler, htu21d_dev_t *dev,
+                          const htu21d_channel_config_t channels[HTU21D_CHANNELS]);
+int htu21d_scheduler_next(htu21d_scheduler_t *scheduler, htu21d_reading_t *reading);
+float htu21d_reading_value(const htu21d_reading_t *reading);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_SCHEDULER_H__
@@ -0,0 +1,273 @@
+/**
+ * @file htu21d_spectrum.c
+ * @brief Dominant temperature/humidity cycles of regularly sampled data.
+ *
+ * Per window, in steps:
+ *
+ * 1. collect `size` samples as complex values, raw temperature + j raw
+ *    humidity (status bits cleared, so both stay in code units)
+ * 2. remove the mean, apply a Hann window (and bit-reverse for the portable
+ *    FFT)
+ * 3. FFT: esp-dsp in one step, or one portable radix-2 stage per step
+ * 4. split the two real spectra, `T[k] = (Z[k] + conj(Z[N-k])) / 2` and
+ *    `RH[k] = (Z[k] - conj(Z[N-k])) / 2j`, and keep the largest local maxima
+ *    of each, refined by parabolic interpolation
+ *
+ * Samples that arrive during steps 2-4 are skipped, so windows are separated
+ * by a gap of a few samples, which doesn't matter for non-overlapping
+ * analysis.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include "htu21d_spectrum.h"
+
+#if CONFIG_HTU21D_SPECTRUM
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#if CONFIG_HTU21D_SPECTRUM_ESP_DSP
+#include "esp_dsp.h"
+#endif
+
+#define HTU21D_PI                   3.14159265F
+#define HTU21D_TEMPERATURE_PER_CODE (175.72F / 65536.0F)
+#define HTU21D_HUMIDITY_PER_CODE    (125.0F / 65536.0F)
+
+/**
+ * @brief htu21d_spectrum_t::state values.
+ */
+enum {
+    STATE_COLLECTING,
+    STATE_PREPARE,
+    STATE_TRANSFORM,
+    STATE_ANALYZE,
+};
+
+/**
+ * @brief Squared magnitude of bin `k` of one of the two real spectra packed in
+ * `z`.
+ */
+static float magnitude2(const float *z, uint16_t size, uint16_t k, bool humidity)
+{
+    const float *a = &z[2 * k], *b = &z[2 * ((size - k) & (size - 1))];
+    float re, im;
+
+    if (humidity) {
+        re = a[1] + b[1];
+        im = b[0] - a[0];
+    } else {
+        re = a[0] + b[0];
+        im = a[1] - b[1];
+    }
+    return 0.25F * (re * re + im * im);
+}
+
+static void prepare(htu21d_spectrum_t *spectrum)
+{
+    float *z = spectrum->buffer;
+    uint16_t size = spectrum->size;
+    float mean_t = 0, mean_rh = 0;
+
+    for (uint16_t i = 0; i < size; i++) {
+        mean_t += z[2 * i];
+        mean_rh += z[2 * i + 1];
+    }
+    mean_t /= size;
+    mean_rh /= size;
+
+    spectrum->window_sum = 0;
+    for (uint16_t i = 0; i < size; i++) {
+        float w = 0.5F - 0.5F * cosf(2.0F * HTU21D_PI * i / size);
+        z[2 * i] = (z[2 * i] - mean_t) * w;
+        z[2 * i + 1] = (z[2 * i + 1] - mean_rh) * w;
+        spectrum->window_sum += w;
+    }
+
+#if !CONFIG_HTU21D_SPECTRUM_ESP_DSP
+    // bit-reversed order for the in-place decimation in time stages
+    for (uint16_t i = 1, j = 0; i < size; i++) {
+        uint16_t bit = size >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float re = z[2 * i], im = z[2 * i + 1];
+            z[2 * i] = z[2 * j];
+            z[2 * i + 1] = z[2 * j + 1];
+            z[2 * j] = re;
+            z[2 * j + 1] = im;
+        }
+    }
+#endif
+    spectrum->stage = 0;
+}
+
+/**
+ * @brief Runs the FFT, or its next stage.
+ * @return Returns `true` when the transform is complete.
+ */
+static bool transform(htu21d_spectrum_t *spectrum)
+{
+#if CONFIG_HTU21D_SPECTRUM_ESP_DSP
+    dsps_fft2r_fc32(spectrum->buffer, spectrum->size);
+    dsps_bit_rev_fc32(spectrum->buffer, spectrum->size);
+    return true;
+#else
+    float *z = spectrum->buffer;
+    uint16_t half = 1 << spectrum->stage, span = half << 1;
+
+    // twiddles by recurrence, one cosf()/sinf() pair per stage
+    float step_re = cosf(-HTU21D_PI / half), step_im = sinf(-HTU21D_PI / half);
+    for (uint16_t start = 0; start < spectrum->size; start += span) {
+        float w_re = 1.0F, w_im = 0.0F;
+        for (uint16_t j = 0; j < half; j++) {
+            float *a = &z[2 * (start + j)], *b = &z[2 * (start + j + half)];
+            float t_re = b[0] * w_re - b[1] * w_im;
+            float t_im = b[0] * w_im + b[1] * w_re;
+            b[0] = a[0] - t_re;
+            b[1] = a[1] - t_im;
+            a[0] += t_re;
+            a[1] += t_im;
+            float next = w_re * step_re - w_im * step_im;
+            w_im = w_re * step_im + w_im * step_re;
+            w_re = next;
+        }
+    }
+    if (span >= spectrum->size) {
+        return true;
+    }
+    spectrum->stage++;
+    return false;
+#endif
+}
+
+static void find_cycles(const htu21d_spectrum_t *spectrum, bool humidity, htu21d_cycle_t cycles[HTU21D_SPECTRUM_PEAKS])
+{
+    const float *z = spectrum->buffer;
+    uint16_t size = spectrum->size;
+    float strength[HTU21D_SPECTRUM_PEAKS] = {0};
+
+    memset(cycles, 0, HTU21D_SPECTRUM_PEAKS * sizeof(htu21d_cycle_t));
+    float left = magnitude2(z, size, 0, humidity), middle = magnitude2(z, size, 1, humidity);
+    for (uint16_t k = 1; k < size / 2; k++) {
+        float right = magnitude2(z, size, k + 1, humidity);
+        if (middle > left && middle >= right && middle > strength[HTU21D_SPECTRUM_PEAKS - 1]) {
+            // parabola through the three magnitudes for the true peak
+            float a = sqrtf(left), b = sqrtf(middle), c = sqrtf(right);
+            float curve = a - 2.0F * b + c;
+            float offset = curve < 0 ? 0.5F * (a - c) / curve : 0.0F;
+            float peak = b - 0.25F * (a - c) * offset;
+
+            int slot = HTU21D_SPECTRUM_PEAKS - 1;
+            for (; slot > 0 && middle > strength[slot - 1]; slot--) {
+                strength[slot] = strength[slot - 1];
+                cycles[slot] = cycles[slot - 1];
+            }
+            strength[slot] = middle;
+            cycles[slot].period_s = size * spectrum->interval_s / (k + offset);
+            cycles[slot].amplitude = 2.0F * peak / spectrum->window_sum *
+                                     (humidity ? HTU21D_HUMIDITY_PER_CODE : HTU21D_TEMPERATURE_PER_CODE);
+        }
+        left = middle;
+        middle = right;
+    }
+}
+
+/**
+ * @brief Prepares an analyzer on a caller provided buffer.
+ * @param buffer `2 * size` floats.
+ * @param size Window length, a power of two from #HTU21D_SPECTRUM_MIN_SIZE to
+ * #HTU21D_SPECTRUM_MAX_SIZE. Cycles from `2 * interval_s` to `size *
+ * interval_s / 2` are resolved.
+ * @param interval_s Time between the samples passed to htu21d_spectrum_add().
+ * @return Returns #HTU21D_ERR_OK, #HTU21D_ERR_INVALID_ARG for a bad size or
+ * interval, or #HTU21D_ERR_INSTALL if esp-dsp fails to initialize.
+ */
+int htu21d_spectrum_init(htu21d_spectrum_t *spectrum, float *buffer, uint16_t size, float interval_s)
+{
+    if (spectrum == NULL || buffer == NULL || size < HTU21D_SPECTRUM_MIN_SIZE || size > HTU21D_SPECTRUM_MAX_SIZE ||
+            (size & (size - 1)) != 0 || !(interval_s > 0)) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+#if CONFIG_HTU21D_SPECTRUM_ESP_DSP
+    esp_err_t ret = dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE);
+    if ((ret != ESP_OK && ret != ESP_ERR_DSP_REINITIALIZED) || size > CONFIG_DSP_MAX_FFT_SIZE) {
+        return HTU21D_ERR_INSTALL;
+    }
+#endif
+    *spectrum = (htu21d_spectrum_t) {
+        .buffer = buffer,
+        .size = size,
+        .filled = 0,
+        .state = STATE_COLLECTING,
+        .interval_s = interval_s,
+    };
+    return HTU21D_ERR_OK;
+}
+
+/**
+ * @brief Adds the next sample of the regular series, or, while a full window
+ * is being analyzed, does the next step of that instead (the sample is
+ * skipped then).
+ * @return Returns `true` when this call completed a new result, see
+ * htu21d_spectrum_result().
+ */
+bool htu21d_spectrum_add(htu21d_spectrum_t *spectrum, const htu21d_sample_t *sample)
+{
+    if (spectrum->state != STATE_COLLECTING) {
+        return htu21d_spectrum_step(spectrum);
+    }
+    spectrum->buffer[2 * spectrum->filled] = sample->raw_temperature;
+    spectrum->buffer[2 * spectrum->filled + 1] = sample->raw_humidity;
+    if (++spectrum->filled == spectrum->size) {
+        spectrum->state = STATE_PREPARE;
+    }
+    return false;
+}
+
+/**
+ * @brief Does the next step of analyzing a full window, at most one pass over
+ * it. Lets an idle task finish the analysis between samples.
+ * @return Returns `true` when this call completed a new result.
+ */
+bool htu21d_spectrum_step(htu21d_spectrum_t *spectrum)
+{
+    switch (spectrum->state) {
+
+    case STATE_PREPARE:
+        prepare(spectrum);
+        spectrum->state = STATE_TRANSFORM;
+        return false;
+
+    case STATE_TRANSFORM:
+        if (transform(spectrum)) {
+            spectrum->state = STATE_ANALYZE;
+        }
+        return false;
+
+    case STATE_ANALYZE:
+        find_cycles(spectrum, false, spectrum->result.temperature);
+        find_cycles(spectrum, true, spectrum->result.humidity);
+        spectrum->result.windows++;
+        spectrum->filled = 0;
+        spectrum->state = STATE_COLLECTING;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Cycles found in the last analyzed window (all zero before the first
+ * one).
+ */
+const htu21d_spectrum_result_t *htu21d_spectrum_result(const htu21d_spectrum_t *spectrum)
+{
+    return &spectrum->result;
+}
+
+#endif  // CONFIG_HTU21D_SPECTRUM
@@ -0,0 +1,82 @@
+/**
+ * @file htu21d_spectrum.h
+ * @brief Dominant temperature/humidity cycles of regularly sampled data.
+ *
+ * Collects a window of samples, runs a Hann windowed FFT over it and reports
+ * the strongest cycles of each channel: period and amplitude. Short-cycling
+ * compressors and hunting thermostats show up as strong peaks at a few
+ * minutes' period.
+ *
+ * The work is split into steps of at most one pass over the window, done one
+ * per htu21d_spectrum_add() call once a window is full, so the sampling task
+ * never stalls for a whole transform. Temperature and humidity share one
+ * complex FFT (one channel in the real part, the other in the imaginary
+ * part). With #CONFIG_HTU21D_SPECTRUM_ESP_DSP the transform itself is
+ * esp-dsp's optimized radix-2 FFT, done in one step; otherwise a portable
+ * radix-2 FFT runs one stage per step.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_SPECTRUM_H__
+#define __HTU21D_SPECTRUM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+#if CONFIG_HTU21D_SPECTRUM
+
+#define HTU21D_SPECTRUM_PEAKS       3    /**< Cycles reported per channel. */
+#define HTU21D_SPECTRUM_MIN_SIZE    16   /**< Smallest window, samples. */
+#define HTU21D_SPECTRUM_MAX_SIZE    4096 /**< Largest window, samples. */
+
+/**
+ * @brief A periodic component of a signal.
+ */
+typedef struct {
+    float period_s;               /**< Cycle period, 0 if there is no such peak. */
+    float amplitude;              /**< Peak amplitude (half of peak-to-peak), degC or %RH. */
+} htu21d_cycle_t;
+
+/**
+ * @brief Strongest cycles of the last analyzed window, strongest first.
+ */
+typedef struct {
+    htu21d_cycle_t temperature[HTU21D_SPECTRUM_PEAKS];
+    htu21d_cycle_t humidity[HTU21D_SPECTRUM_PEAKS];
+    uint32_t windows;             /**< Windows analyzed so far. */
+} htu21d_spectrum_result_t;
+
+/**
+ * @brief Analyzer state, treat as opaque.
+ */
+typedef struct {
+    float *buffer;                /**< 2 x size floats: temperature, humidity pairs. */
+    uint16_t size;                /**< Window length, a power of two. */
+    uint16_t filled;              /**< Samples collected in the current window. */
+    uint8_t state;                /**< Next step, see htu21d_spectrum.c. */
+    uint8_t stage;                /**< Portable FFT stages done. */
+    float interval_s;             /**< Time between samples. */
+    float window_sum;             /**< Sum of the window function, for amplitudes. */
+    htu21d_spectrum_result_t result;
+} htu21d_spectrum_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_spectrum_init(htu21d_spectrum_t *spectrum, float *buffer, uint16_t size, float interval_s);
+bool htu21d_spectrum_add(htu21d_spectrum_t *spectrum, const htu21d_sample_t *sample);
+bool htu21d_spectrum_step(htu21d_spectrum_t *spectrum);
+const htu21d_spectrum_result_t *htu21d_spectrum_result(const htu21d_spectrum_t *spectrum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CONFIG_HTU21D_SPECTRUM
+
+#endif  // __HTU21D_SPECTRUM_H__
@@ -0,0 +1,95 @@
+/**
+ * @file htu21d_sweep.c
+ * @brief Time-aligned measurement of many sensors.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include "htu21d_sweep.h"
+#include "htu21d_port.h"
+
+/**
+ * @brief Bus order of the sweep: by port, then sensors wired straight to the
+ * bus, then by mux and channel.
+ */
+static bool comes_before(const htu21d_dev_t *a, const htu21d_dev_t *b)
+{
+    if (a->port != b->port) {
+        return a->port < b->port;
+    }
+    if (a->mux_address != b->mux_address) {
+        return a->mux_address < b->mux_address;
+    }
+    return a->mux_channel < b->mux_channel;
+}
+
+/**
+ * @brief Measures `command` on all `devs` at (nearly) the same time.
+ *
+ * Uses the no hold master commands whatever the devices'
+ * htu21d_dev_t::read_mode, and single conversions (no oversampling). Every
+ * sensor's fetch counts for its circuit breaker.
+ * @param devs Sensors, in any order.
+ * @param command #TRIGGER_TEMP_MEASURE_NOHOLD or #TRIGGER_HUMD_MEASURE_NOHOLD.
+ * @param[out] results One per sensor, in the order of `devs`.
+ * @return Returns #HTU21D_ERR_OK if every sensor was read (a CRC error only
+ * shows in its result), #HTU21D_ERR_FAIL if any sensor failed, or
+ * #HTU21D_ERR_INVALID_ARG for more than #HTU21D_SWEEP_MAX_SENSORS sensors or
+ * another command.
+ */
+int htu21d_sweep(htu21d_dev_t *devs, size_t count, uint8_t command, htu21d_sweep_result_t *results)
+{
+    uint8_t order[HTU21D_SWEEP_MAX_SENSORS];
+
+    if (devs == NULL || results == NULL || count > HTU21D_SWEEP_MAX_SENSORS ||
+            (command != TRIGGER_TEMP_MEASURE_NOHOLD && command != TRIGGER_HUMD_MEASURE_NOHOLD)) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    if (count == 0) {
+        return HTU21D_ERR_OK;
+    }
+
+    // insertion sort, stable so equal positions keep the caller's order
+    for (size_t i = 0; i < count; i++) {
+        size_t j = i;
+        for (; j > 0 && comes_before(&devs[i], &devs[order[j - 1]]); j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = (uint8_t) i;
+    }
+
+    // trigger burst
+    uint32_t wait_ms = 0;
+    uint64_t first_us = 0;
+    for (size_t i = 0; i < count; i++) {
+        htu21d_dev_t *dev = &devs[order[i]];
+        htu21d_sweep_result_t *result = &results[order[i]];
+
+        result->status = htu21d_dev_start_measurement(dev, command);
+        result->trigger_us = htu21d_port_time_us();
+        result->raw = 0;
+        if (i == 0) {
+            first_us = result->trigger_us;
+        }
+        result->skew_us = (uint32_t)(result->trigger_us - first_us);
+        if (result->status == HTU21D_ERR_OK) {
+            uint32_t time_ms = htu21d_conversion_time_ms(dev->resolution, command);
+            wait_ms = time_ms > wait_ms ? time_ms : wait_ms;
+        }
+    }
+
+    // the last one triggered is done after its conversion time, the others before
+    htu21d_port_delay_ms(wait_ms);
+
+    int ret = HTU21D_ERR_OK;
+    for (size_t i = 0; i < count; i++) {
+        htu21d_sweep_result_t *result = &results[order[i]];
+        if (result->status == HTU21D_ERR_OK) {
+            result->status = htu21d_dev_fetch_measurement(&devs[order[i]], &result->raw);
+        }
+        if (result->status != HTU21D_ERR_OK && result->status != HTU21D_ERR_CRC) {
+            ret = HTU21D_ERR_FAIL;
+        }
+    }
+    return ret;
+}
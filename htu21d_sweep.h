@@ -0,0 +1,46 @@
+/**
+ * @file htu21d_sweep.h
+ * @brief Time-aligned measurement of many sensors.
+ *
+ * A sweep triggers the conversion of every sensor in one burst, waits once
+ * for the slowest one and then reads them all back, so the sensors measure
+ * within a fraction of a millisecond of each other instead of one conversion
+ * time apart. The burst goes bus by bus and mux by mux, channels in order, so
+ * every mux is opened once. The time each conversion was actually triggered
+ * is reported per sensor.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_SWEEP_H__
+#define __HTU21D_SWEEP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+#define HTU21D_SWEEP_MAX_SENSORS    128 /**< Most sensors in one sweep: two buses of eight muxes with eight channels. */
+
+/**
+ * @brief Outcome of a sweep for one sensor.
+ */
+typedef struct {
+    int status;                   /**< #HTU21D_ERR_OK, #HTU21D_ERR_CRC (raw kept) or the sensor's error. */
+    uint16_t raw;                 /**< Raw code with the status bits cleared. */
+    uint64_t trigger_us;          /**< When the conversion was triggered, see htu21d_port_time_us(). */
+    uint32_t skew_us;             /**< Trigger time after the sweep's first trigger. */
+} htu21d_sweep_result_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int htu21d_sweep(htu21d_dev_t *devs, size_t count, uint8_t command, htu21d_sweep_result_t *results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_SWEEP_H__
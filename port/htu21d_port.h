@@ -0,0 +1,106 @@
+/**
+ * @file htu21d_port.h
+ * @brief HTU21D Sensor transport layer (private header).
+ *
+ * The driver core in htu21d.c never touches the I2C peripheral directly, it
+ * only calls the functions declared here. Exactly one implementation is linked
+ * in per platform:
+ *
+ * | File                 | Platform                                       |
+ * |----------------------|------------------------------------------------|
+ * | htu21d_port_esp.c    | ESP-IDF, legacy I2C driver (`driver/i2c.h`)    |
+ * | htu21d_port_linux.c  | Linux, i2c-dev (`/dev/i2c-N`) `I2C_RDWR` ioctl |
+ *
+ * Every bus function returns one of the `HTU21D_ERR_*` codes, so timing,
+ * CRC checking and error handling stay in the shared driver core.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __HTU21D_PORT_H__
+#define __HTU21D_PORT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "htu21d.h"
+
+#if !CONFIG_HTU21D_LOGGING
+#define HTU21D_LOGE(tag, format, ...) do { (void) (tag); } while (0)
+#define HTU21D_LOGW(tag, format, ...) do { (void) (tag); } while (0)
+#elif defined(ESP_PLATFORM)
+#include "esp_log.h"
+#define HTU21D_LOGE(tag, format, ...) ESP_LOGE(tag, format, ##__VA_ARGS__)
+#define HTU21D_LOGW(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+#else
+#include <stdio.h>
+#define HTU21D_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define HTU21D_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configures the bus pins and clock (I2C master @ 100,000).
+ *
+ * On Linux the pins and pull-ups are fixed by the board/device tree, so the
+ * arguments are only validated.
+ */
+int htu21d_port_bus_config(i2c_port_t port, int sda_pin, int scl_pin,
+                           gpio_pullup_t sda_internal_pullup,
+                           gpio_pullup_t scl_internal_pullup);
+
+/**
+ * @brief Installs the bus driver (ESP-IDF) or opens `/dev/i2c-<port>` (Linux).
+ */
+int htu21d_port_bus_install(i2c_port_t port);
+
+/**
+ * @brief Addresses the device with an empty write to check that it ACKs.
+ */
+int htu21d_port_probe(i2c_port_t port, uint8_t address, uint32_t timeout_ms);
+
+/**
+ * @brief Single write transaction: START, address+W, `data`, STOP.
+ */
+int htu21d_port_write(i2c_port_t port, uint8_t address, const uint8_t *data,
+                      size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Single read transaction: START, address+R, `data`, STOP.
+ *
+ * Every byte is ACKed except the last one, which is NACKed.
+ */
+int htu21d_port_read(i2c_port_t port, uint8_t address, uint8_t *data,
+                     size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Combined transaction: START, address+W, `write_data`, repeated
+ * START, address+R, `read_data`, STOP.
+ */
+int htu21d_port_write_read(i2c_port_t port, uint8_t address,
+                           const uint8_t *write_data, size_t write_len,
+                           uint8_t *read_data, size_t read_len,
+                           uint32_t timeout_ms);
+
+/**
+ * @brief Blocks the calling task/thread for at least `ms` milliseconds.
+ */
+void htu21d_port_delay_ms(uint32_t ms);
+
+/**
+ * @brief Monotonic time in microseconds, for timestamping samples.
+ *
+ * Only differences are meaningful: the epoch is boot (ESP-IDF) or an
+ * unspecified point (Linux `CLOCK_MONOTONIC`).
+ */
+uint64_t htu21d_port_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HTU21D_PORT_H__
@@ -0,0 +1,181 @@
+/**
+ * @file htu21d_port_esp.c
+ * @brief HTU21D Sensor transport layer for ESP-IDF (legacy I2C driver).
+ *
+ * @author Luca Dentella, www.lucadentella.it
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include "driver/i2c.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "htu21d_port.h"
+
+/**
+ * @brief Command link buffer size, enough for a write + repeated START + read.
+ *
+ * Links are built in a buffer on the caller's stack, so no transaction touches
+ * the heap. i2c_cmd_link_create() would allocate the link and every command
+ * in it, about ten small blocks per measurement.
+ */
+#define HTU21D_CMD_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)
+
+/**
+ * @brief Command link buffer, in pointer-sized words since the driver lays
+ * out its link structures in it.
+ */
+typedef uintptr_t htu21d_cmd_buffer_t[(HTU21D_CMD_LINK_SIZE + sizeof(uintptr_t) - 1) / sizeof(uintptr_t)];
+
+static const char* TAG = "htu21d_port";
+
+/**
+ * @brief Maps an ESP-IDF error code to the matching `HTU21D_ERR_*` code.
+ */
+static int to_htu21d_err(esp_err_t ret)
+{
+    switch (ret) {
+
+    case ESP_OK:
+        return HTU21D_ERR_OK;
+
+    case ESP_ERR_INVALID_ARG:
+        return HTU21D_ERR_INVALID_ARG;
+
+    case ESP_ERR_INVALID_STATE:
+        return HTU21D_ERR_INVALID_STATE;
+
+    case ESP_ERR_TIMEOUT:
+        return HTU21D_ERR_TIMEOUT;
+    }
+    return HTU21D_ERR_FAIL;
+}
+
+/**
+ * @brief Starts a command link in `buffer` with a START and the address byte.
+ * @return Returns the link, or `NULL` if the driver rejected the buffer.
+ */
+static i2c_cmd_handle_t cmd_begin(htu21d_cmd_buffer_t buffer, uint8_t address, i2c_rw_t rw)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static((uint8_t *) buffer, sizeof(htu21d_cmd_buffer_t));
+    if (cmd == NULL) {
+        HTU21D_LOGE(TAG, "i2c_cmd_link_create_static: buffer rejected");
+        return NULL;
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, (address << 1) | rw, true));
+    return cmd;
+}
+
+/**
+ * @brief Executes a queued command link and releases it.
+ */
+static int cmd_run(i2c_port_t port, i2c_cmd_handle_t cmd, uint32_t timeout_ms)
+{
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_stop(cmd));
+    esp_err_t ret = i2c_master_cmd_begin(port, cmd, timeout_ms / portTICK_PERIOD_MS);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(ret);
+    i2c_cmd_link_delete_static(cmd);
+
+    return to_htu21d_err(ret);
+}
+
+/**
+ * @brief Queues `len` reads into `cmd`, ACKing every byte but the last.
+ */
+static void cmd_queue_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len)
+{
+    if (len > 1) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_read(cmd, data, len - 1, I2C_MASTER_ACK));
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_read_byte(cmd, data + len - 1, I2C_MASTER_NACK));
+}
+
+int htu21d_port_bus_config(i2c_port_t port, int sda_pin, int scl_pin,
+                           gpio_pullup_t sda_internal_pullup,
+                           gpio_pullup_t scl_internal_pullup)
+{
+    i2c_config_t conf = {0};
+    conf.mode = I2C_MODE_MASTER;
+    conf.sda_io_num = sda_pin;
+    conf.scl_io_num = scl_pin;
+    conf.sda_pullup_en = sda_internal_pullup;
+    conf.scl_pullup_en = scl_internal_pullup;
+    conf.master.clk_speed = 100000;
+    esp_err_t ret = i2c_param_config(port, &conf);
+    if (ret != ESP_OK) {
+        HTU21D_LOGE(TAG, "i2c_param_config: %s", esp_err_to_name(ret));
+    }
+    return to_htu21d_err(ret);
+}
+
+int htu21d_port_bus_install(i2c_port_t port)
+{
+    esp_err_t ret = i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0);
+    if (ret != ESP_OK) {
+        HTU21D_LOGE(TAG, "i2c_driver_install: %s", esp_err_to_name(ret));
+    }
+    return to_htu21d_err(ret);
+}
+
+int htu21d_port_probe(i2c_port_t port, uint8_t address, uint32_t timeout_ms)
+{
+    htu21d_cmd_buffer_t buffer;
+    i2c_cmd_handle_t cmd = cmd_begin(buffer, address, I2C_MASTER_WRITE);
+    if (cmd == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    return cmd_run(port, cmd, timeout_ms);
+}
+
+int htu21d_port_write(i2c_port_t port, uint8_t address, const uint8_t *data,
+                      size_t len, uint32_t timeout_ms)
+{
+    htu21d_cmd_buffer_t buffer;
+    i2c_cmd_handle_t cmd = cmd_begin(buffer, address, I2C_MASTER_WRITE);
+    if (cmd == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write(cmd, data, len, true));
+    return cmd_run(port, cmd, timeout_ms);
+}
+
+int htu21d_port_read(i2c_port_t port, uint8_t address, uint8_t *data,
+                     size_t len, uint32_t timeout_ms)
+{
+    htu21d_cmd_buffer_t buffer;
+    i2c_cmd_handle_t cmd = cmd_begin(buffer, address, I2C_MASTER_READ);
+    if (cmd == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    cmd_queue_read(cmd, data, len);
+    return cmd_run(port, cmd, timeout_ms);
+}
+
+int htu21d_port_write_read(i2c_port_t port, uint8_t address,
+                           const uint8_t *write_data, size_t write_len,
+                           uint8_t *read_data, size_t read_len,
+                           uint32_t timeout_ms)
+{
+    htu21d_cmd_buffer_t buffer;
+    i2c_cmd_handle_t cmd = cmd_begin(buffer, address, I2C_MASTER_WRITE);
+    if (cmd == NULL) {
+        return HTU21D_ERR_FAIL;
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write(cmd, write_data, write_len, true));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_start(cmd));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_READ, true));
+    cmd_queue_read(cmd, read_data, read_len);
+    return cmd_run(port, cmd, timeout_ms);
+}
+
+void htu21d_port_delay_ms(uint32_t ms)
+{
+    // round up, short polling delays must not turn into a bare yield
+    vTaskDelay((ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+}
+
+uint64_t htu21d_port_time_us(void)
+{
+    return (uint64_t) esp_timer_get_time();
+}
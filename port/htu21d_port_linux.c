@@ -0,0 +1,225 @@
+/**
+ * @file htu21d_port_linux.c
+ * @brief HTU21D Sensor transport layer for Linux i2c-dev.
+ *
+ * The I2C port number passed to htu21d_init() selects the `/dev/i2c-<port>`
+ * adapter. Every transaction is issued as one `I2C_RDWR` ioctl, so a combined
+ * write/read gets a real repeated START instead of two separate transfers.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "htu21d_port.h"
+
+#define HTU21D_LINUX_MAX_ADAPTERS 32 /**< Highest `/dev/i2c-N` number + 1 that can be opened. */
+
+static const char* TAG = "htu21d_port";
+
+/**
+ * @brief An open i2c-dev adapter.
+ */
+typedef struct {
+    int fd;               /**< File descriptor, or `-1` if not installed. */
+    uint32_t timeout_ms;  /**< Timeout last programmed with `I2C_TIMEOUT`. */
+} htu21d_adapter_t;
+
+static htu21d_adapter_t _adapters[HTU21D_LINUX_MAX_ADAPTERS];
+static bool _adapters_ready = false;
+
+static void adapters_setup(void)
+{
+    if (!_adapters_ready) {
+        for (int i = 0; i < HTU21D_LINUX_MAX_ADAPTERS; i++) {
+            _adapters[i].fd = -1;
+        }
+        _adapters_ready = true;
+    }
+}
+
+/**
+ * @brief Maps an ioctl `errno` to the matching `HTU21D_ERR_*` code.
+ *
+ * A NACK shows up as `ENXIO`/`EREMOTEIO`/`EIO` depending on the adapter, all
+ * of which map to #HTU21D_ERR_FAIL like `ESP_FAIL` does on ESP-IDF.
+ */
+static int to_htu21d_err(int err)
+{
+    switch (err) {
+
+    case 0:
+        return HTU21D_ERR_OK;
+
+    case EINVAL:
+        return HTU21D_ERR_INVALID_ARG;
+
+    case EBADF:
+        return HTU21D_ERR_INVALID_STATE;
+
+    case ETIMEDOUT:
+        return HTU21D_ERR_TIMEOUT;
+    }
+    return HTU21D_ERR_FAIL;
+}
+
+/**
+ * @brief Runs `count` messages as a single `I2C_RDWR` transfer.
+ */
+static int transfer(i2c_port_t port, struct i2c_msg *msgs, int count, uint32_t timeout_ms)
+{
+    if (port < 0 || port >= HTU21D_LINUX_MAX_ADAPTERS) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    adapters_setup();
+    htu21d_adapter_t *adapter = &_adapters[port];
+    if (adapter->fd < 0) {
+        return HTU21D_ERR_INVALID_STATE;
+    }
+
+    // I2C_TIMEOUT is in units of 10 ms and sticks to the file descriptor
+    if (timeout_ms != adapter->timeout_ms) {
+        if (ioctl(adapter->fd, I2C_TIMEOUT, (timeout_ms + 9) / 10) < 0) {
+            HTU21D_LOGW(TAG, "I2C_TIMEOUT: %s", strerror(errno));
+        }
+        adapter->timeout_ms = timeout_ms;
+    }
+
+    struct i2c_rdwr_ioctl_data data = {
+        .msgs = msgs,
+        .nmsgs = count,
+    };
+    if (ioctl(adapter->fd, I2C_RDWR, &data) < 0) {
+        return to_htu21d_err(errno);
+    }
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_bus_config(i2c_port_t port, int sda_pin, int scl_pin,
+                           gpio_pullup_t sda_internal_pullup,
+                           gpio_pullup_t scl_internal_pullup)
+{
+    (void) sda_pin;
+    (void) scl_pin;
+    (void) sda_internal_pullup;
+    (void) scl_internal_pullup;
+
+    if (port < 0 || port >= HTU21D_LINUX_MAX_ADAPTERS) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_bus_install(i2c_port_t port)
+{
+    char path[20];
+
+    if (port < 0 || port >= HTU21D_LINUX_MAX_ADAPTERS) {
+        return HTU21D_ERR_INVALID_ARG;
+    }
+    adapters_setup();
+    if (_adapters[port].fd >= 0) {
+        // same as i2c_driver_install() on an already installed port
+        return HTU21D_ERR_INVALID_STATE;
+    }
+
+    snprintf(path, sizeof(path), "/dev/i2c-%d", port);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        HTU21D_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+        return HTU21D_ERR_FAIL;
+    }
+
+    unsigned long funcs = 0;
+    if (ioctl(fd, I2C_FUNCS, &funcs) < 0 || !(funcs & I2C_FUNC_I2C)) {
+        HTU21D_LOGE(TAG, "%s does not support plain I2C transfers", path);
+        close(fd);
+        return HTU21D_ERR_FAIL;
+    }
+
+    _adapters[port].fd = fd;
+    _adapters[port].timeout_ms = 0;
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_probe(i2c_port_t port, uint8_t address, uint32_t timeout_ms)
+{
+    struct i2c_msg msg = {
+        .addr = address,
+        .flags = 0,
+        .len = 0,
+        .buf = NULL,
+    };
+    return transfer(port, &msg, 1, timeout_ms);
+}
+
+int htu21d_port_write(i2c_port_t port, uint8_t address, const uint8_t *data,
+                      size_t len, uint32_t timeout_ms)
+{
+    struct i2c_msg msg = {
+        .addr = address,
+        .flags = 0,
+        .len = len,
+        .buf = (uint8_t *) data,
+    };
+    return transfer(port, &msg, 1, timeout_ms);
+}
+
+int htu21d_port_read(i2c_port_t port, uint8_t address, uint8_t *data,
+                     size_t len, uint32_t timeout_ms)
+{
+    struct i2c_msg msg = {
+        .addr = address,
+        .flags = I2C_M_RD,
+        .len = len,
+        .buf = data,
+    };
+    return transfer(port, &msg, 1, timeout_ms);
+}
+
+int htu21d_port_write_read(i2c_port_t port, uint8_t address,
+                           const uint8_t *write_data, size_t write_len,
+                           uint8_t *read_data, size_t read_len,
+                           uint32_t timeout_ms)
+{
+    struct i2c_msg msgs[2] = {
+        {
+            .addr = address,
+            .flags = 0,
+            .len = write_len,
+            .buf = (uint8_t *) write_data,
+        },
+        {
+            .addr = address,
+            .flags = I2C_M_RD,
+            .len = read_len,
+            .buf = read_data,
+        },
+    };
+    return transfer(port, msgs, 2, timeout_ms);
+}
+
+void htu21d_port_delay_ms(uint32_t ms)
+{
+    struct timespec ts = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (long)(ms % 1000) * 1000000L,
+    };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+uint64_t htu21d_port_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000ULL;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file mock_port.c
+ * @brief Recording mock of the HTU21D transport layer for host tests.
+ *
+ * Heap allocations are counted by linking the test with
+ * `-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc`, which routes the driver's
+ * calls through the `__wrap_*` functions below.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdlib.h>
+#include "htu21d_port.h"
+#include "mock_port.h"
+
+static mock_port_stats_t _stats;
+static uint8_t _user_register;
+static uint8_t _last_command;
+static uint16_t _raw_temperature;
+static uint16_t _raw_humidity;
+static unsigned _bad_crcs;
+static bool _unplugged;
+static unsigned _failed_reads;
+static uint64_t _now_us; /**< Advanced by delays only, never reset. */
+static void (*_delay_hook)(void);
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    _stats.heap_allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    _stats.heap_allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    _stats.heap_allocations++;
+    return __real_realloc(ptr, size);
+}
+
+// CRC-8 with polynomial x^8 + x^5 + x^4 + 1, as sent by the sensor
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+void mock_port_reset(void)
+{
+    _stats = (mock_port_stats_t) {
+        0
+    };
+    _user_register = 0x02;
+    _last_command = 0;
+    _raw_temperature = 0x6658;  // ~23.4 degC
+    _raw_humidity = 0x7C80;     // ~54.8 %RH
+    _bad_crcs = 0;
+    _unplugged = false;
+    _failed_reads = 0;
+    _delay_hook = NULL;
+}
+
+mock_port_stats_t mock_port_stats(void)
+{
+    return _stats;
+}
+
+void mock_port_set_raw(uint16_t raw_temperature, uint16_t raw_humidity)
+{
+    _raw_temperature = raw_temperature;
+    _raw_humidity = raw_humidity;
+}
+
+void mock_port_corrupt_crc(unsigned count)
+{
+    _bad_crcs = count;
+}
+
+uint8_t mock_port_user_register(void)
+{
+    return _user_register;
+}
+
+void mock_port_unplug(bool unplugged)
+{
+    _unplugged = unplugged;
+}
+
+void mock_port_fail_reads(unsigned count)
+{
+    _failed_reads = count;
+}
+
+void mock_port_set_delay_hook(void (*hook)(void))
+{
+    _delay_hook = hook;
+}
+
+static void sensor_write(const uint8_t *data, size_t len)
+{
+    _stats.bytes_written += len;
+    if (len == 0) {
+        return;
+    }
+    _last_command = data[0];
+    if (data[0] == WRITE_USER_REG && len == 2) {
+        _user_register = data[1];
+    } else if (data[0] == SOFT_RESET) {
+        _user_register = 0x02;
+    }
+}
+
+static void sensor_read(uint8_t *data, size_t len)
+{
+    uint8_t answer[3] = {0};
+    uint16_t raw = 0;
+
+    _stats.bytes_read += len;
+    switch (_last_command) {
+
+    case READ_USER_REG:
+        answer[0] = _user_register;
+        break;
+
+    case TRIGGER_TEMP_MEASURE_HOLD:
+    case TRIGGER_TEMP_MEASURE_NOHOLD:
+        raw = _raw_temperature;
+        break;
+
+    case TRIGGER_HUMD_MEASURE_HOLD:
+    case TRIGGER_HUMD_MEASURE_NOHOLD:
+        raw = _raw_humidity | 0x02;
+        break;
+    }
+    if (_last_command != READ_USER_REG) {
+        answer[0] = raw >> 8;
+        answer[1] = raw & 0xFF;
+        answer[2] = crc8(answer, 2);
+        if (_bad_crcs > 0) {
+            _bad_crcs--;
+            answer[2] ^= 0xFF;
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        data[i] = i < sizeof(answer) ? answer[i] : 0xFF;
+    }
+}
+
+// an unplugged sensor lets the transaction run into its timeout
+static bool timed_out(uint8_t address, uint32_t timeout_ms)
+{
+    if (!_unplugged || address != HTU21D_ADDR) {
+        return false;
+    }
+    _stats.timeout_ms += timeout_ms;
+    _now_us += timeout_ms * 1000ULL;
+    return true;
+}
+
+int htu21d_port_bus_config(i2c_port_t port, int sda_pin, int scl_pin,
+                           gpio_pullup_t sda_internal_pullup,
+                           gpio_pullup_t scl_internal_pullup)
+{
+    (void) port;
+    (void) sda_pin;
+    (void) scl_pin;
+    (void) sda_internal_pullup;
+    (void) scl_internal_pullup;
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_bus_install(i2c_port_t port)
+{
+    (void) port;
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_probe(i2c_port_t port, uint8_t address, uint32_t timeout_ms)
+{
+    (void) port;
+    _stats.transactions++;
+    if (timed_out(address, timeout_ms)) {
+        return HTU21D_ERR_TIMEOUT;
+    }
+    return address == HTU21D_ADDR ? HTU21D_ERR_OK : HTU21D_ERR_FAIL;
+}
+
+int htu21d_port_write(i2c_port_t port, uint8_t address, const uint8_t *data,
+                      size_t len, uint32_t timeout_ms)
+{
+    (void) port;
+    _stats.transactions++;
+    if (timed_out(address, timeout_ms)) {
+        return HTU21D_ERR_TIMEOUT;
+    }
+    if (address >= 0x70 && address <= 0x77) {
+        // TCA9548A channel select
+        _stats.bytes_written += len;
+        return HTU21D_ERR_OK;
+    }
+    if (address != HTU21D_ADDR) {
+        return HTU21D_ERR_FAIL;
+    }
+    sensor_write(data, len);
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_read(i2c_port_t port, uint8_t address, uint8_t *data,
+                     size_t len, uint32_t timeout_ms)
+{
+    (void) port;
+    _stats.transactions++;
+    if (timed_out(address, timeout_ms)) {
+        return HTU21D_ERR_TIMEOUT;
+    }
+    if (address != HTU21D_ADDR) {
+        return HTU21D_ERR_FAIL;
+    }
+    if (_failed_reads > 0) {
+        _failed_reads--;
+        _stats.timeout_ms += timeout_ms;
+        _now_us += timeout_ms * 1000ULL;
+        return HTU21D_ERR_TIMEOUT;
+    }
+    sensor_read(data, len);
+    return HTU21D_ERR_OK;
+}
+
+int htu21d_port_write_read(i2c_port_t port, uint8_t address,
+                           const uint8_t *write_data, size_t write_len,
+                           uint8_t *read_data, size_t read_len,
+                           uint32_t timeout_ms)
+{
+    (void) port;
+    _stats.transactions++;
+    if (timed_out(address, timeout_ms)) {
+        return HTU21D_ERR_TIMEOUT;
+    }
+    if (address != HTU21D_ADDR) {
+        return HTU21D_ERR_FAIL;
+    }
+    sensor_write(write_data, write_len);
+    sensor_read(read_data, read_len);
+    return HTU21D_ERR_OK;
+}
+
+void htu21d_port_delay_ms(uint32_t ms)
+{
+    _stats.delay_ms += ms;
+    _now_us += ms * 1000ULL;
+    if (_delay_hook != NULL) {
+        _delay_hook();
+    }
+}
+
+uint64_t htu21d_port_time_us(void)
+{
+    return _now_us;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file mock_port.h
+ * @brief Recording mock of the HTU21D transport layer for host tests.
+ *
+ * Implements every `htu21d_port_*` function against an in-memory fake sensor
+ * and counts what the driver core asks of the bus, so tests can assert the
+ * exact number of transactions and bytes each public API costs. Writes to
+ * 0x70-0x77 are ACKed as TCA9548A mux channel selects.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __MOCK_PORT_H__
+#define __MOCK_PORT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bus activity recorded since the last mock_port_reset().
+ */
+typedef struct {
+    unsigned transactions;    /**< START...STOP sequences (a repeated start does not count). */
+    unsigned bytes_written;   /**< Payload bytes sent, address bytes excluded. */
+    unsigned bytes_read;      /**< Payload bytes received, address bytes excluded. */
+    unsigned delay_ms;        /**< Total time spent in htu21d_port_delay_ms(). */
+    unsigned timeout_ms;      /**< Time lost to transactions the unplugged sensor never answered. */
+    unsigned heap_allocations; /**< malloc()/calloc()/realloc() calls made by the driver. */
+} mock_port_stats_t;
+
+/**
+ * @brief Clears the statistics and resets the fake sensor to power-on state.
+ */
+void mock_port_reset(void);
+
+/**
+ * @brief Returns the statistics recorded since the last mock_port_reset().
+ */
+mock_port_stats_t mock_port_stats(void);
+
+/**
+ * @brief Sets the raw code the fake sensor returns for measurements.
+ */
+void mock_port_set_raw(uint16_t raw_temperature, uint16_t raw_humidity);
+
+/**
+ * @brief Sends a wrong CRC with the next `count` measurements.
+ */
+void mock_port_corrupt_crc(unsigned count);
+
+/**
+ * @brief Unplugs or plugs back the fake sensor. Transactions to an unplugged
+ * sensor time out, advancing the clock by their timeout.
+ */
+void mock_port_unplug(bool unplugged);
+
+/**
+ * @brief Lets the next `count` plain reads of the fake sensor time out, as if
+ * it ACKed a measurement command but then hung.
+ */
+void mock_port_fail_reads(unsigned count);
+
+/**
+ * @brief Returns the fake sensor's user register.
+ */
+uint8_t mock_port_user_register(void);
+
+/**
+ * @brief Calls `hook` from every htu21d_port_delay_ms(), after the clock has
+ * advanced, to act as another task running meanwhile. Cleared by
+ * mock_port_reset().
+ */
+void mock_port_set_delay_hook(void (*hook)(void));
+
+#endif  // __MOCK_PORT_H__
@@ -0,0 +1,30 @@
+/**
+ * @file test_check.h
+ * @brief Assertion shared by the host tests.
+ *
+ * A failed check is reported with its file and line and counted in
+ * `_failures`; the test keeps going so one run shows every mismatch.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#pragma once
+
+#ifndef __TEST_CHECK_H__
+#define __TEST_CHECK_H__
+
+#include <stdio.h>
+
+static int _failures = 0;
+
+#define CHECK_EQ(actual, expected)                                              \
+    do {                                                                        \
+        long _a = (long)(actual), _e = (long)(expected);                        \
+        if (_a != _e) {                                                         \
+            fprintf(stderr, "%s:%d: %s == %ld, expected %ld\n",                 \
+                    __FILE__, __LINE__, #actual, _a, _e);                       \
+            _failures++;                                                        \
+        }                                                                       \
+    } while (0)
+
+#endif  // __TEST_CHECK_H__
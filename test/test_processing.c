@@ -0,0 +1,284 @@
+/**
+ * @file test_processing.c
+ * @brief Results of the sample processing modules and the derived math.
+ *
+ * These modules only compute on samples the application hands them. run()
+ * checks for every one of them that it stays off the bus and the heap.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "htu21d.h"
+#include "htu21d_accumulator.h"
+#include "htu21d_anomaly.h"
+#include "htu21d_kalman.h"
+#include "htu21d_mold.h"
+#include "htu21d_spectrum.h"
+#include "mock_port.h"
+#include "test_check.h"
+
+#if CONFIG_HTU21D_SPECTRUM
+static void test_spectrum(void)
+{
+    static float buffer[2 * 64];
+    htu21d_spectrum_t spectrum;
+    htu21d_sample_t sample;
+
+    CHECK_EQ(htu21d_spectrum_init(&spectrum, buffer, 48, 10.0F), HTU21D_ERR_INVALID_ARG);
+    CHECK_EQ(htu21d_spectrum_init(&spectrum, buffer, 64, 10.0F), HTU21D_ERR_OK);
+
+    // 80 s temperature cycle of 800 codes, 320 s humidity cycle of 1000 codes
+    int ready_at = 0;
+    for (int i = 0; i < 64 + 8 && ready_at == 0; i++) {
+        uint16_t code_t = (uint16_t)(0x6000 + 800.0F * sinf(6.2831853F * i / 8)) & 0xFFFC;
+        uint16_t code_rh = (uint16_t)(0x7000 + 1000.0F * sinf(6.2831853F * i / 32)) & 0xFFFC;
+        htu21d_sample_from_raw(&sample, code_t, code_rh, 0x00, HTU21D_SAMPLE_CRC_OK, i * 10000000ULL);
+        ready_at = htu21d_spectrum_add(&spectrum, &sample) ? i + 1 : 0;
+    }
+    // window, then prepare + 6 FFT stages + analyze, one per sample
+    CHECK_EQ(ready_at, 64 + 8);
+
+    const htu21d_spectrum_result_t *result = htu21d_spectrum_result(&spectrum);
+    CHECK_EQ(result->windows, 1);
+    CHECK_EQ(fabsf(result->temperature[0].period_s - 80.0F) < 1.0F, 1);
+    CHECK_EQ(fabsf(result->temperature[0].amplitude - 800 * 175.72F / 65536) < 0.05F, 1);
+    CHECK_EQ(fabsf(result->humidity[0].period_s - 320.0F) < 4.0F, 1);
+    CHECK_EQ(fabsf(result->humidity[0].amplitude - 1000 * 125.0F / 65536) < 0.05F, 1);
+}
+#endif  // CONFIG_HTU21D_SPECTRUM
+
+static void test_anomaly(void)
+{
+    htu21d_anomaly_t detector;
+    htu21d_anomaly_event_t events[HTU21D_ANOMALY_CHANNELS];
+    htu21d_sample_t sample;
+    int total = 0, detected_at = 0;
+
+    htu21d_anomaly_config_t config = HTU21D_ANOMALY_CONFIG_DEFAULT;
+    config.ewma_weight = 0;
+    CHECK_EQ(htu21d_anomaly_init(&detector, &config), HTU21D_ERR_INVALID_ARG);
+    CHECK_EQ(htu21d_anomaly_init(&detector, NULL), HTU21D_ERR_OK);
+
+    // 100 samples of 23 degC / 50 %RH +- one code, then the temperature steps up 0.5 degC
+    for (int i = 0; i < 140; i++) {
+        uint16_t code_t = (uint16_t)(0x6218 + (i % 2) * 4 + (i >= 100 ? 188 : 0));
+        htu21d_sample_from_raw(&sample, code_t, 0x7C80 + (i % 3) * 4, 0x00, HTU21D_SAMPLE_CRC_OK, i * 1000000ULL);
+        int n = htu21d_anomaly_update(&detector, &sample, events);
+        for (int e = 0; e < n; e++) {
+            CHECK_EQ(events[e].channel == HTU21D_ANOMALY_HUMIDITY, 0);
+            if (events[e].channel == HTU21D_ANOMALY_TEMPERATURE) {
+                CHECK_EQ(events[e].kind & HTU21D_ANOMALY_CUSUM_UP, HTU21D_ANOMALY_CUSUM_UP);
+                CHECK_EQ(events[e].value - events[e].baseline > 0.4F, 1);
+                detected_at = detected_at ? detected_at : i;
+            }
+        }
+        total += n;
+    }
+    // the step is caught within a few samples, once on temperature and once on dew point
+    CHECK_EQ(detected_at >= 100 && detected_at <= 103, 1);
+    CHECK_EQ(total, CONFIG_HTU21D_DERIVED_MATH ? 2 : 1);
+
+    // samples that failed their CRC are ignored
+    uint32_t samples = detector.samples;
+    htu21d_sample_from_raw(&sample, 0xF000, 0x7C80, 0x00, 0x00, 141 * 1000000ULL);
+    CHECK_EQ(htu21d_anomaly_update(&detector, &sample, events), 0);
+    CHECK_EQ(detector.samples, samples);
+}
+
+static void test_kalman(void)
+{
+    htu21d_kalman_config_t config = {
+        .temperature_drift = 0.005F,
+        .humidity_drift = 0.02F,
+        .drift_correlation = -0.5F,
+    };
+    htu21d_kalman_t quiet, noisy;
+    htu21d_sample_t sample;
+
+    CHECK_EQ(htu21d_kalman_init(&quiet, &(htu21d_kalman_config_t) {
+        .temperature_drift = 2.0F, .humidity_drift = 0.02F,
+    }, NULL), HTU21D_ERR_INVALID_ARG);
+    CHECK_EQ(htu21d_kalman_init(&quiet, &config, NULL), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_kalman_init(&noisy, &config, NULL), HTU21D_ERR_OK);
+
+    // 20.42 degC / 52.59 %RH, +- about the noise of 12-bit temperature and 8-bit humidity
+    int32_t min_t = INT32_MAX, max_t = INT32_MIN;
+    for (int i = 0; i < 200; i++) {
+        uint16_t code_t = (uint16_t)(0x6200 + (i % 2 ? 16 : -16));
+        uint16_t code_rh = (uint16_t)(0x7800 + (i % 2 ? 360 : -360)) & 0xFFFC;
+        htu21d_sample_from_raw(&sample, code_t, code_rh, 0x00, HTU21D_SAMPLE_CRC_OK, 0);
+        CHECK_EQ(htu21d_kalman_update(&quiet, &sample), HTU21D_ERR_OK);
+        htu21d_sample_from_raw(&sample, code_t, code_rh, 0x01, HTU21D_SAMPLE_CRC_OK, 0);
+        CHECK_EQ(htu21d_kalman_update(&noisy, &sample), HTU21D_ERR_OK);
+        if (i >= 150) {
+            min_t = noisy.temperature < min_t ? noisy.temperature : min_t;
+            max_t = noisy.temperature > max_t ? noisy.temperature : max_t;
+        }
+    }
+    // the raw readings swing 86 mdegC and 1373 m%RH
+    CHECK_EQ(max_t - min_t < 10, 1);
+    CHECK_EQ(noisy.temperature > 20400 && noisy.temperature < 20440, 1);
+    CHECK_EQ(noisy.humidity > 52500 && noisy.humidity < 52700, 1);
+
+    // warming by 1 degC: the quiet resolution is trusted more and follows faster,
+    // and the correlated drift pulls the humidity estimate down with it
+    int32_t humidity_before = noisy.humidity;
+    for (int i = 0; i < 5; i++) {
+        htu21d_sample_from_raw(&sample, 0x6200 + 372, 0x7800, 0x00, HTU21D_SAMPLE_CRC_OK, 0);
+        htu21d_kalman_update(&quiet, &sample);
+        htu21d_sample_from_raw(&sample, 0x6200 + 372, 0x7800, 0x01, HTU21D_SAMPLE_CRC_OK, 0);
+        htu21d_kalman_update(&noisy, &sample);
+    }
+    CHECK_EQ(quiet.temperature > noisy.temperature, 1);
+    CHECK_EQ(noisy.humidity < humidity_before, 1);
+
+    // a sample that failed its CRC leaves the estimates alone
+    int32_t temperature = noisy.temperature;
+    htu21d_sample_from_raw(&sample, 0xF000, 0x7800, 0x01, 0x00, 0);
+    CHECK_EQ(htu21d_kalman_update(&noisy, &sample), HTU21D_ERR_CRC);
+    CHECK_EQ(noisy.temperature, temperature);
+}
+
+#if CONFIG_HTU21D_DERIVED_MATH
+static void test_mold(void)
+{
+    htu21d_mold_t mold;
+
+    CHECK_EQ(sizeof(htu21d_mold_t), 16);
+    CHECK_EQ(htu21d_mold_init(&mold, HTU21D_MOLD_VERY_SENSITIVE, 0), HTU21D_ERR_INVALID_ARG);
+    CHECK_EQ(htu21d_mold_init(&mold, HTU21D_MOLD_VERY_SENSITIVE, 1.0F), HTU21D_ERR_OK);
+
+    // pine at 20 degC / 97 %RH: microscopic growth after about 10 days, visible after about 20
+    for (int h = 0; h < 10 * 24; h++) {
+        CHECK_EQ(htu21d_mold_update(&mold, 20.0F, 97.0F, 3600), HTU21D_ERR_OK);
+    }
+    CHECK_EQ(mold.index > 0.9F && mold.index < 1.0F, 1);
+    for (int h = 0; h < 20 * 24; h++) {
+        htu21d_mold_update(&mold, 20.0F, 97.0F, 3600);
+    }
+    CHECK_EQ(mold.index > 4.6F && mold.index < 4.8F, 1);
+
+    // two dry days in one step: 6 h at -0.00133/h, a pause until 24 h, then -0.000667/h
+    float index = mold.index;
+    CHECK_EQ(htu21d_mold_update(&mold, 20.0F, 50.0F, 48 * 3600), HTU21D_ERR_OK);
+    CHECK_EQ(fabsf(index - mold.index - 0.02399F) < 0.0001F, 1);
+    CHECK_EQ(mold.unfavorable_s, 48 * 3600);
+
+    // failed readings are rejected
+    CHECK_EQ(htu21d_mold_update(&mold, -999.0F, 97.0F, 3600), HTU21D_ERR_INVALID_ARG);
+    CHECK_EQ(mold.unfavorable_s, 48 * 3600);
+
+    // so is a model that was never set up
+    CHECK_EQ(htu21d_mold_update(NULL, 20.0F, 97.0F, 3600), HTU21D_ERR_INVALID_ARG);
+    mold.sensitivity = HTU21D_MOLD_RESISTANT + 1;
+    CHECK_EQ(htu21d_mold_update(&mold, 20.0F, 97.0F, 3600), HTU21D_ERR_INVALID_ARG);
+}
+#endif  // CONFIG_HTU21D_DERIVED_MATH
+
+static void test_accumulator(void)
+{
+    htu21d_accumulator_config_t config = {
+        .heating_base = 18.0F,
+        .cooling_base = 18.0F,
+        .temperature_high = 19.0F,
+        .temperature_low = 10.0F,
+        .humidity_high = 60.0F,
+        .humidity_low = 30.0F,
+        .max_gap_s = 3600,
+    };
+    htu21d_accumulator_t accumulator;
+    htu21d_sample_t sample;
+
+    CHECK_EQ(htu21d_accumulator_init(&accumulator, &config, NULL), HTU21D_ERR_OK);
+
+    // 16 degC rising to 20 degC over an hour at 46 %RH: crosses 18 degC halfway, 19 degC at 3/4
+    htu21d_sample_from_raw(&sample, 23440, 0x6A00, 0x00, HTU21D_SAMPLE_CRC_OK, 0);
+    CHECK_EQ(htu21d_accumulator_add(&accumulator, &sample), HTU21D_ERR_OK);
+    htu21d_sample_from_raw(&sample, 24932, 0x6A00, 0x00, HTU21D_SAMPLE_CRC_OK, 3600000000ULL);
+    CHECK_EQ(htu21d_accumulator_add(&accumulator, &sample), HTU21D_ERR_OK);
+    // 1 degC x 1800 s / 2 each side
+    CHECK_EQ(llabs((long long) accumulator.totals.heating_mdeg_s - 1800000) < 2000, 1);
+    CHECK_EQ(llabs((long long) accumulator.totals.cooling_mdeg_s - 1800000) < 2000, 1);
+    CHECK_EQ(llabs((long long) accumulator.totals.temperature_above_ms - 900000) < 1000, 1);
+
+    // then 400 s later, still 20 degC
+    htu21d_sample_from_raw(&sample, 24932, 0x6A00, 0x00, HTU21D_SAMPLE_CRC_OK, 4000000000ULL);
+    htu21d_accumulator_add(&accumulator, &sample);
+    CHECK_EQ(llabs((long long) accumulator.totals.cooling_mdeg_s - 2600000) < 2000, 1);
+    CHECK_EQ(llabs((long long) accumulator.totals.temperature_above_ms - 1300000) < 1000, 1);
+    CHECK_EQ(accumulator.totals.temperature_below_ms, 0);
+    CHECK_EQ(accumulator.totals.humidity_above_ms + accumulator.totals.humidity_below_ms, 0);
+    CHECK_EQ(accumulator.totals.covered_ms, 4000000);
+
+    // a two hour gap isn't integrated, going back in time is refused
+    htu21d_sample_from_raw(&sample, 24932, 0x6A00, 0x00, HTU21D_SAMPLE_CRC_OK, 11200000000ULL);
+    CHECK_EQ(htu21d_accumulator_add(&accumulator, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(accumulator.totals.covered_ms, 4000000);
+    htu21d_sample_from_raw(&sample, 24932, 0x6A00, 0x00, HTU21D_SAMPLE_CRC_OK, 11100000000ULL);
+    CHECK_EQ(htu21d_accumulator_add(&accumulator, &sample), HTU21D_ERR_INVALID_ARG);
+
+    // totals carry over a restart
+    htu21d_totals_t saved = accumulator.totals;
+    CHECK_EQ(htu21d_accumulator_init(&accumulator, &config, &saved), HTU21D_ERR_OK);
+    CHECK_EQ(accumulator.totals.covered_ms, 4000000);
+}
+
+#if CONFIG_HTU21D_DERIVED_MATH
+static void test_derived_math(void)
+{
+    float dew_point = htu21d_compute_dew_point(25.0F, 50.0F);
+    CHECK_EQ(dew_point > 13.5F && dew_point < 14.5F, 1);
+    htu21_compute_compensated_humidity(30.0F, 50.0F);
+    celsius_to_fahrenheit(30.0F);
+
+    // 25 degC / 50 %RH at sea level: about 9.8 g/kg and 50 kJ/kg
+    float ratio = htu21d_compute_humidity_ratio(25.0F, 50.0F, 101.325F);
+    CHECK_EQ(ratio > 0.0095F && ratio < 0.0100F, 1);
+    float enthalpy = htu21d_compute_enthalpy(25.0F, ratio);
+    CHECK_EQ(enthalpy > 49.5F && enthalpy < 50.7F, 1);
+    const float temperatures[3] = {-10.0F, 25.0F, 40.0F}, humidities[3] = {80.0F, 50.0F, 20.0F};
+    htu21d_moist_air_t air[3];
+    htu21d_compute_moist_air_batch(temperatures, humidities, 101.325F, 3, air);
+    CHECK_EQ(fabsf(air[1].humidity_ratio - ratio) < 1e-7F && fabsf(air[1].enthalpy - enthalpy) < 1e-4F, 1);
+    CHECK_EQ(air[0].enthalpy < 0 && air[2].enthalpy > enthalpy, 1);
+}
+#endif  // CONFIG_HTU21D_DERIVED_MATH
+
+/**
+ * @brief Runs the cases of one module, which must not touch the bus or the heap.
+ */
+static void run(void (*test)(void))
+{
+    mock_port_reset();
+    test();
+    mock_port_stats_t stats = mock_port_stats();
+    CHECK_EQ(stats.transactions, 0);
+    CHECK_EQ(stats.delay_ms, 0);
+    CHECK_EQ(stats.heap_allocations, 0);
+}
+
+int main(void)
+{
+#if CONFIG_HTU21D_SPECTRUM
+    run(test_spectrum);
+#endif
+    run(test_anomaly);
+    run(test_kalman);
+#if CONFIG_HTU21D_DERIVED_MATH
+    run(test_mold);
+#endif
+    run(test_accumulator);
+#if CONFIG_HTU21D_DERIVED_MATH
+    run(test_derived_math);
+#endif
+
+    if (_failures) {
+        fprintf(stderr, "%d check(s) failed\n", _failures);
+        return EXIT_FAILURE;
+    }
+    printf("All processing checks passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,739 @@
+/**
+ * @file test_transactions.c
+ * @brief Bus transaction, byte and heap allocation counts of the public API.
+ *
+ * Extra round trips are how performance regressions show up in this driver,
+ * so every public function is pinned to the exact bus cost it has today. If a
+ * change legitimately alters one of these numbers, update the expectation in
+ * the same commit.
+ *
+ * @author rob4226 <rob4226@yahoo.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "htu21d.h"
+#include "htu21d_cache.h"
+#include "htu21d_governor.h"
+#include "htu21d_history.h"
+#include "htu21d_port.h"
+#include "htu21d_queue.h"
+#include "htu21d_scheduler.h"
+#include "htu21d_sweep.h"
+#include "mock_port.h"
+#include "test_check.h"
+
+/**
+ * @brief Checks the bus cost recorded since the last mock_port_reset().
+ */
+#define CHECK_COST(n_transactions, n_written, n_read, n_delay_ms)               \
+    do {                                                                        \
+        mock_port_stats_t _s = mock_port_stats();                               \
+        CHECK_EQ(_s.transactions, n_transactions);                              \
+        CHECK_EQ(_s.bytes_written, n_written);                                  \
+        CHECK_EQ(_s.bytes_read, n_read);                                        \
+        CHECK_EQ(_s.delay_ms, n_delay_ms);                                      \
+        CHECK_EQ(_s.heap_allocations, 0);                                       \
+    } while (0)
+
+static void test_init(void)
+{
+    mock_port_reset();
+    CHECK_EQ(htu21d_init(0, 1, 2, GPIO_PULLUP_ENABLE, GPIO_PULLUP_ENABLE), HTU21D_ERR_OK);
+    // address-only probe
+    CHECK_COST(1, 0, 0, 0);
+}
+
+static void test_read_temperature(void)
+{
+    mock_port_reset();
+    float temperature = htu21d_read_temperature();
+    CHECK_EQ(temperature > 23.0F && temperature < 24.0F, 1);
+    // trigger, fixed wait, fetch MSB/LSB/CRC
+    CHECK_COST(2, 1, 3, 50);
+}
+
+static void test_read_humidity(void)
+{
+    mock_port_reset();
+    float humidity = htu21d_read_humidity();
+    CHECK_EQ(humidity > 54.0F && humidity < 56.0F, 1);
+    // max 12-bit RH conversion time
+    CHECK_COST(2, 1, 3, 16);
+}
+
+static void test_read_value(void)
+{
+    mock_port_reset();
+    mock_port_set_raw(0x1234, 0);
+    CHECK_EQ(read_value(TRIGGER_TEMP_MEASURE_NOHOLD), 0x1234);
+    CHECK_COST(2, 1, 3, 50);
+}
+
+static void test_get_resolution(void)
+{
+    mock_port_reset();
+    CHECK_EQ(htu21d_get_resolution(), 0x00);
+    // combined command + register read
+    CHECK_COST(1, 1, 1, 0);
+}
+
+static void test_set_resolution(void)
+{
+    mock_port_reset();
+    CHECK_EQ(htu21d_set_resolution(0x81), HTU21D_ERR_OK);
+    // read-modify-write of the user register
+    CHECK_COST(2, 3, 1, 0);
+    CHECK_EQ(mock_port_user_register(), 0x83);
+
+    CHECK_EQ(htu21d_set_resolution(0x80), HTU21D_ERR_OK);
+    CHECK_EQ(mock_port_user_register(), 0x82);
+
+    // starting from a non-default resolution the old bits are cleared, not
+    // OR-ed into the new ones, and the heater bit is kept
+    CHECK_EQ(htu21d_write_user_register(0x87), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_set_resolution(0x00), HTU21D_ERR_OK);
+    CHECK_EQ(mock_port_user_register(), 0x06);
+    CHECK_EQ(htu21d_set_resolution(0x01), HTU21D_ERR_OK);
+    CHECK_EQ(mock_port_user_register(), 0x07);
+    CHECK_EQ(htu21d_write_user_register(0x82), HTU21D_ERR_OK);
+
+    // the wait follows the resolution: 13-bit temperature
+    mock_port_reset();
+    htu21d_read_temperature();
+    CHECK_COST(2, 1, 3, 25);
+    htu21d_set_resolution(0x00);
+}
+
+static void test_soft_reset(void)
+{
+    mock_port_reset();
+    CHECK_EQ(htu21d_soft_reset(), HTU21D_ERR_OK);
+    CHECK_COST(1, 1, 0, 0);
+}
+
+static void test_user_register(void)
+{
+    mock_port_reset();
+    CHECK_EQ(htu21d_read_user_register(), 0x02);
+    CHECK_COST(1, 1, 1, 0);
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_write_user_register(0x03), HTU21D_ERR_OK);
+    CHECK_EQ(mock_port_user_register(), 0x03);
+    CHECK_COST(1, 2, 0, 0);
+    htu21d_write_user_register(0x02);
+}
+
+static void test_read_modes(void)
+{
+    htu21d_dev_t *dev = htu21d_get_default_dev();
+
+    // the mock answers right away, so polling stops after the typical time
+    mock_port_reset();
+    dev->read_mode = HTU21D_READ_MODE_POLLING;
+    htu21d_read_temperature();
+    CHECK_COST(2, 1, 3, 44);
+
+    // one combined transaction, the sensor stretches the clock
+    mock_port_reset();
+    dev->read_mode = HTU21D_READ_MODE_HOLD;
+    htu21d_read_temperature();
+    CHECK_COST(1, 1, 3, 0);
+
+    dev->read_mode = HTU21D_READ_MODE_FIXED_WAIT;
+}
+
+static void test_pipelined(void)
+{
+    htu21d_dev_t *dev = htu21d_get_default_dev();
+    uint16_t raw;
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_dev_start_measurement(dev, TRIGGER_TEMP_MEASURE_NOHOLD), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_dev_fetch_measurement(dev, &raw), HTU21D_ERR_OK);
+    CHECK_EQ(raw, 0x6658);
+    CHECK_COST(2, 1, 3, 0);
+    CHECK_EQ(htu21d_dev_fetch_measurement(dev, &raw), HTU21D_ERR_INVALID_STATE);
+}
+
+static void test_mux(void)
+{
+    htu21d_dev_t a, b;
+
+    // channel select + probe
+    mock_port_reset();
+    CHECK_EQ(htu21d_dev_init(&a, 1, 0x70, 0), HTU21D_ERR_OK);
+    CHECK_COST(2, 1, 0, 0);
+
+    // channel already selected
+    mock_port_reset();
+    htu21d_dev_read_temperature(&a);
+    CHECK_COST(2, 1, 3, 50);
+
+    // another channel of the same mux: one select
+    mock_port_reset();
+    CHECK_EQ(htu21d_dev_init(&b, 1, 0x70, 1), HTU21D_ERR_OK);
+    CHECK_COST(2, 1, 0, 0);
+
+    // another mux: close the first one, then select
+    mock_port_reset();
+    CHECK_EQ(htu21d_dev_init(&b, 1, 0x71, 3), HTU21D_ERR_OK);
+    CHECK_COST(3, 2, 0, 0);
+}
+
+static void test_sample(void)
+{
+    htu21d_sample_t sample;
+
+    // two measurements, nothing converted
+    mock_port_reset();
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_COST(4, 2, 6, 66);
+    CHECK_EQ(sample.raw_temperature, 0x6658);
+    CHECK_EQ(sample.converted, 0);
+
+    // converted once, then served from the record
+    float temperature = htu21d_sample_temperature(&sample);
+    CHECK_EQ(temperature > 23.0F && temperature < 24.0F, 1);
+    sample.raw_temperature = 0;
+    CHECK_EQ(htu21d_sample_temperature(&sample) == temperature, 1);
+#if CONFIG_HTU21D_DERIVED_MATH
+    float dew_point = htu21d_sample_dew_point(&sample);
+    CHECK_EQ(dew_point > 13.0F && dew_point < 15.0F, 1);
+#endif
+
+    // the timestamp follows the port clock
+    uint64_t first_us = sample.timestamp_us;
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.timestamp_us - first_us, 66000);
+
+    htu21d_sample_from_raw(&sample, 0x6658, 0x7000, 0x00, HTU21D_SAMPLE_CRC_OK, 0);
+    CHECK_EQ(sample.converted, 0);
+}
+
+static void test_sample_flags(void)
+{
+    htu21d_sample_t sample;
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK);
+
+    // one bad CRC: the conversion is repeated
+    mock_port_reset();
+    mock_port_corrupt_crc(1);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_RETRIED);
+    CHECK_COST(6, 3, 9, 116);
+
+    // the retry fails too: kept, but flagged
+    mock_port_reset();
+    mock_port_corrupt_crc(2);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_RETRIED);
+
+    // read_value() still returns the value
+    mock_port_reset();
+    mock_port_corrupt_crc(1);
+    CHECK_EQ(read_value(TRIGGER_TEMP_MEASURE_NOHOLD), 0x6658);
+
+    // range, heater and battery from the codes and the cached user register
+    mock_port_reset();
+    mock_port_set_raw(0x6658, 0xFF00);
+    htu21d_get_default_dev()->user_register |= 0x44;
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_OUT_OF_RANGE |
+             HTU21D_SAMPLE_HEATER_ON | HTU21D_SAMPLE_LOW_BATTERY);
+    htu21d_get_default_dev()->user_register = 0x02;
+
+    // resolution index in the top bits
+    htu21d_set_resolution(0x81);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags & HTU21D_SAMPLE_RESOLUTION_MASK, HTU21D_SAMPLE_RESOLUTION_MASK);
+    CHECK_EQ(HTU21D_SAMPLE_RESOLUTION(sample.flags), 0x81);
+    htu21d_set_resolution(0x00);
+}
+
+static void test_oversampling(void)
+{
+    htu21d_dev_t *dev = htu21d_get_default_dev();
+
+    // four full conversions, averaged
+    mock_port_reset();
+    mock_port_set_raw(0x1234, 0);
+    dev->temperature_oversampling = 4;
+    CHECK_EQ(read_value(TRIGGER_TEMP_MEASURE_NOHOLD), 0x1234);
+    CHECK_COST(8, 4, 12, 200);
+
+    // humidity isn't oversampled
+    mock_port_reset();
+    htu21d_read_humidity();
+    CHECK_COST(2, 1, 3, 16);
+    dev->temperature_oversampling = 1;
+}
+
+static void test_plan(void)
+{
+    htu21d_plan_t plan;
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_plan(&(htu21d_goal_t) {
+        .temperature_noise = 0.02F, .humidity_noise = 0.1F
+    }, NULL, &plan), HTU21D_ERR_OK);
+    CHECK_EQ(plan.resolution, 0x80);
+    CHECK_EQ(plan.temperature_oversampling, 1);
+    CHECK_EQ(plan.humidity_oversampling, 4);
+    CHECK_EQ(plan.latency_ms, 45);
+
+    // the quietest configuration within 20 ms
+    CHECK_EQ(htu21d_plan(&(htu21d_goal_t) {
+        .latency_ms = 20
+    }, NULL, &plan), HTU21D_ERR_OK);
+    CHECK_EQ(plan.latency_ms <= 20, 1);
+
+    CHECK_EQ(htu21d_plan(&(htu21d_goal_t) {
+        .temperature_noise = 0.001F
+    }, NULL, &plan), HTU21D_ERR_NOTFOUND);
+    CHECK_EQ(htu21d_plan(&(htu21d_goal_t) {0}, NULL, &plan), HTU21D_ERR_INVALID_ARG);
+    // pure computation
+    CHECK_COST(0, 0, 0, 0);
+
+    // one read-modify-write of the user register
+    mock_port_reset();
+    CHECK_EQ(htu21d_plan(&(htu21d_goal_t) {
+        .temperature_noise = 0.02F, .humidity_noise = 0.1F
+    }, NULL, &plan), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_dev_apply_plan(htu21d_get_default_dev(), &plan), HTU21D_ERR_OK);
+    CHECK_COST(2, 3, 1, 0);
+    CHECK_EQ(htu21d_get_default_dev()->humidity_oversampling, 4);
+
+    htu21d_dev_apply_plan(htu21d_get_default_dev(), &(htu21d_plan_t) {
+        .resolution = 0x00, .temperature_oversampling = 1, .humidity_oversampling = 1
+    });
+}
+
+static void test_queue(void)
+{
+    htu21d_queue_slot_t slots[4];
+    htu21d_queue_t queue;
+    htu21d_record_t record = {0};
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_queue_init(&queue, slots, 3), HTU21D_ERR_INVALID_ARG);
+    CHECK_EQ(htu21d_queue_init(&queue, slots, 4), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_queue_pop(&queue, &record), false);
+
+    // fills up, then drops and counts
+    for (uint16_t i = 0; i < 6; i++) {
+        record.source = i;
+        CHECK_EQ(htu21d_queue_push(&queue, &record), i < 4);
+    }
+    CHECK_EQ(htu21d_queue_overflows(&queue), 2);
+
+    // FIFO order, across the wrap
+    CHECK_EQ(htu21d_queue_pop(&queue, &record) && record.source == 0, 1);
+    record.source = 4;
+    CHECK_EQ(htu21d_queue_push(&queue, &record), true);
+    for (uint16_t i = 1; i <= 4; i++) {
+        CHECK_EQ(htu21d_queue_pop(&queue, &record) && record.source == i, 1);
+    }
+    CHECK_EQ(htu21d_queue_pop(&queue, &record), false);
+    // no bus, no heap
+    CHECK_COST(0, 0, 0, 0);
+}
+
+static void test_history(void)
+{
+    uint64_t timestamps[4];
+    uint16_t raw_t[4], raw_rh[4];
+    uint8_t flags[4];
+    htu21d_history_t history;
+    htu21d_history_stats_t stats;
+    htu21d_sample_t sample;
+    uint32_t count;
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_history_init(&history, 4, timestamps, raw_t, raw_rh, flags), HTU21D_ERR_OK);
+
+    // six samples at t = 0..5 s into four entries: 2..5 s are kept
+    for (uint16_t s = 0; s < 6; s++) {
+        htu21d_sample_from_raw(&sample, 0x6000 + 4 * s, 0x7000 - 4 * s, 0x00,
+                               s == 3 ? 0 : HTU21D_SAMPLE_CRC_OK, s * 1000000ULL);
+        CHECK_EQ(htu21d_history_push(&history, &sample), HTU21D_ERR_OK);
+    }
+    CHECK_EQ(history.count, 4);
+    // timestamps must not go backwards
+    sample.timestamp_us = 0;
+    CHECK_EQ(htu21d_history_push(&history, &sample), HTU21D_ERR_INVALID_ARG);
+
+    CHECK_EQ(htu21d_history_get(&history, 0, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.timestamp_us, 2000000);
+    CHECK_EQ(htu21d_history_find(&history, 2500000, 5000000, &count), 1);
+    CHECK_EQ(count, 2);
+
+    // across the wrap, 2..5 s, then without the bad CRC at 3 s
+    CHECK_EQ(htu21d_history_stats(&history, 0, 4, 0, 0, &stats), HTU21D_ERR_OK);
+    CHECK_EQ(stats.count, 4);
+    CHECK_EQ(stats.min_temperature, 0x6008);
+    CHECK_EQ(stats.max_temperature, 0x6014);
+    CHECK_EQ(stats.mean_temperature, 0x600E);
+    CHECK_EQ(stats.max_humidity, 0x6FF8);
+    CHECK_EQ(htu21d_history_stats(&history, 0, 4, HTU21D_SAMPLE_CRC_OK, HTU21D_SAMPLE_CRC_OK, &stats),
+             HTU21D_ERR_OK);
+    CHECK_EQ(stats.count, 3);
+    CHECK_EQ(htu21d_history_stats(&history, 4, 0, 0, 0, &stats), HTU21D_ERR_NOTFOUND);
+    CHECK_EQ(htu21d_history_stats(&history, 3, 2, 0, 0, &stats), HTU21D_ERR_INVALID_ARG);
+    CHECK_COST(0, 0, 0, 0);
+}
+
+static void test_downsample(void)
+{
+    uint64_t timestamps[16];
+    uint16_t raw_t[16], raw_rh[16];
+    uint8_t flags[16];
+    uint32_t indices[16];
+    htu21d_history_t history;
+    htu21d_sample_t sample;
+
+    // flat line with one spike at 5 s
+    htu21d_history_init(&history, 16, timestamps, raw_t, raw_rh, flags);
+    for (uint16_t s = 0; s < 12; s++) {
+        htu21d_sample_from_raw(&sample, s == 5 ? 0x7000 : 0x6000, 0x7000, 0x00, 0, s * 1000000ULL);
+        htu21d_history_push(&history, &sample);
+    }
+
+    // ends kept, the spike survives
+    CHECK_EQ(htu21d_history_downsample(&history, 0, 12, HTU21D_HISTORY_TEMPERATURE, indices, 4), 4);
+    CHECK_EQ(indices[0], 0);
+    CHECK_EQ(indices[1], 5);
+    CHECK_EQ(indices[2], 6);
+    CHECK_EQ(indices[3], 11);
+
+    CHECK_EQ(htu21d_history_downsample(&history, 2, 3, HTU21D_HISTORY_HUMIDITY, indices, 4), 3);
+    CHECK_EQ(indices[2], 4);
+    CHECK_EQ(htu21d_history_downsample(&history, 0, 12, HTU21D_HISTORY_TEMPERATURE, indices, 2), 0);
+    CHECK_EQ(htu21d_history_downsample(&history, 10, 3, HTU21D_HISTORY_TEMPERATURE, indices, 4), 0);
+}
+
+static void test_governor(void)
+{
+    htu21d_governor_config_t config = {
+        .duty_permille = 100,
+        .window_ms = 1000,
+        .coalesce = false,
+    };
+    htu21d_governor_t governor;
+    htu21d_sample_t sample;
+
+    // 66 ms readings against a 100 ms budget draining at 10 %
+    mock_port_reset();
+    CHECK_EQ(htu21d_governor_init(&governor, htu21d_get_default_dev(), &config), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_governor_wait_ms(&governor), 0);
+    CHECK_EQ(htu21d_governor_read_sample(&governor, &sample), HTU21D_ERR_OK);
+    CHECK_COST(4, 2, 6, 66);
+
+    // the second one waits for room in the bucket, then every one is spaced
+    // to 10 % duty
+    CHECK_EQ(htu21d_governor_wait_ms(&governor), 320);
+    mock_port_reset();
+    CHECK_EQ(htu21d_governor_read_sample(&governor, &sample), HTU21D_ERR_OK);
+    CHECK_COST(4, 2, 6, 320 + 66);
+    mock_port_reset();
+    CHECK_EQ(htu21d_governor_read_sample(&governor, &sample), HTU21D_ERR_OK);
+    CHECK_COST(4, 2, 6, 594 + 66);
+    CHECK_EQ(sample.flags & HTU21D_SAMPLE_STALE, 0);
+    CHECK_EQ(governor.duty_permille > 100 && governor.duty_permille < 170, 1);
+
+    // coalescing serves the last reading instead, without touching the bus
+    governor.config.coalesce = true;
+    mock_port_reset();
+    CHECK_EQ(htu21d_governor_read_sample(&governor, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_STALE);
+    CHECK_EQ(sample.raw_temperature, 0x6658);
+    CHECK_COST(0, 0, 0, 0);
+
+    // a reading longer than the whole budget waits for an empty bucket
+    config.window_ms = 500;
+    CHECK_EQ(htu21d_governor_init(&governor, htu21d_get_default_dev(), &config), HTU21D_ERR_OK);
+    htu21d_governor_read_sample(&governor, &sample);
+    CHECK_EQ(htu21d_governor_wait_ms(&governor), 660);
+
+    config.duty_permille = 0;
+    CHECK_EQ(htu21d_governor_init(&governor, htu21d_get_default_dev(), &config), HTU21D_ERR_INVALID_ARG);
+}
+
+static htu21d_cache_t _cache;
+
+/**
+ * @brief Another task finishing the measurement it has in flight.
+ */
+static void finish_other_measurement(void)
+{
+    htu21d_sample_from_raw(&_cache.sample, 0x5000, 0x7000, 0x00, HTU21D_SAMPLE_CRC_OK, htu21d_port_time_us());
+    _cache.has_sample = true;
+    _cache.result = HTU21D_ERR_OK;
+    _cache.generation += 2;
+    _cache.busy = 0;
+    mock_port_set_delay_hook(NULL);
+}
+
+static htu21d_sample_t _other_sample;
+static int _other_result;
+
+/**
+ * @brief Another task that won the measurement with an outdated snapshot:
+ * it backs off, then finds the current reading fresh enough for its own
+ * max age and returns without measuring.
+ */
+static void back_off_other_caller(void)
+{
+    mock_port_set_delay_hook(NULL);
+    _cache.busy = 0;
+    _other_result = htu21d_read_cached(&_cache, 1000000, &_other_sample);
+}
+
+static void test_cache(void)
+{
+    htu21d_sample_t sample;
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_cache_init(&_cache, htu21d_get_default_dev()), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_read_cached(&_cache, 1000000, &sample), HTU21D_ERR_OK);
+    CHECK_COST(4, 2, 6, 66);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK);
+
+    // fresh enough: served from the cache without touching the bus
+    mock_port_reset();
+    CHECK_EQ(htu21d_read_cached(&_cache, 1000000, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_STALE);
+    CHECK_EQ(sample.raw_temperature, 0x6658);
+    CHECK_COST(0, 0, 0, 0);
+
+    // too old for this caller: measured again
+    CHECK_EQ(htu21d_read_cached(&_cache, 50000, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK);
+    CHECK_COST(4, 2, 6, 66);
+
+    // another caller's measurement in flight: wait for it and share it
+    mock_port_reset();
+    _cache.busy = 1;
+    mock_port_set_delay_hook(finish_other_measurement);
+    CHECK_EQ(htu21d_read_cached(&_cache, 0, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(sample.raw_temperature, 0x5000);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK);
+    CHECK_COST(0, 0, 0, 1);
+
+    // the other caller backs off without measuring: measure instead of
+    // waiting for a result nobody produces
+    mock_port_reset();
+    _cache.busy = 1;
+    mock_port_set_delay_hook(back_off_other_caller);
+    CHECK_EQ(htu21d_read_cached(&_cache, 0, &sample), HTU21D_ERR_OK);
+    CHECK_EQ(_other_result, HTU21D_ERR_OK);
+    CHECK_EQ(_other_sample.raw_temperature, 0x5000);
+    CHECK_EQ(_other_sample.flags, HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_STALE);
+    CHECK_EQ(sample.raw_temperature, 0x6658);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK);
+    CHECK_COST(4, 2, 6, 1 + 66);
+}
+
+static void test_breaker(void)
+{
+    htu21d_sample_t sample;
+    htu21d_dev_t *dev = htu21d_get_default_dev();
+
+    // every read of an unplugged sensor runs into the I2C timeout...
+    mock_port_reset();
+    mock_port_unplug(true);
+    for (int i = 0; i < HTU21D_BREAKER_THRESHOLD; i++) {
+        CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_TIMEOUT);
+    }
+    CHECK_EQ(mock_port_stats().timeout_ms, HTU21D_BREAKER_THRESHOLD * 1000);
+
+    // ...until the breaker opens: then they fail without touching the bus
+    mock_port_reset();
+    mock_port_unplug(true);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_UNAVAILABLE);
+    CHECK_EQ(htu21d_read_temperature(), -999);
+    CHECK_COST(0, 0, 0, 0);
+
+    // after the backoff a short probe, failing, doubles the wait
+    htu21d_port_delay_ms(100);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_UNAVAILABLE);
+    CHECK_EQ(mock_port_stats().transactions, 1);
+    CHECK_EQ(mock_port_stats().timeout_ms, 10);
+    CHECK_EQ(dev->backoff_ms, 200);
+    htu21d_port_delay_ms(100);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_UNAVAILABLE);
+    CHECK_EQ(mock_port_stats().transactions, 1);
+
+    // a cache hands out its last reading, flagged, meanwhile
+    htu21d_cache_init(&_cache, dev);
+    htu21d_sample_from_raw(&_cache.sample, 0x6658, 0x7C80, 0x00, HTU21D_SAMPLE_CRC_OK, 0);
+    _cache.has_sample = true;
+    CHECK_EQ(htu21d_read_cached(&_cache, 1000, &sample), HTU21D_ERR_UNAVAILABLE);
+    CHECK_EQ(sample.flags, HTU21D_SAMPLE_CRC_OK | HTU21D_SAMPLE_STALE);
+    CHECK_EQ(mock_port_stats().transactions, 1);
+
+    // plugged back: the next probe succeeds and the breaker closes
+    mock_port_reset();
+    htu21d_port_delay_ms(100);
+    CHECK_EQ(htu21d_read_sample(&sample), HTU21D_ERR_OK);
+    CHECK_COST(1 + 4, 2, 6, 100 + 66);
+    CHECK_EQ(dev->failures, 0);
+    CHECK_EQ(dev->backoff_ms, 100);
+}
+
+static void test_scheduler(void)
+{
+    const htu21d_channel_config_t channels[HTU21D_CHANNELS] = {
+        [HTU21D_CHANNEL_TEMPERATURE] = {.period_ms = 100, .resolution = 0x81},
+        [HTU21D_CHANNEL_HUMIDITY] = {.period_ms = 1000, .resolution = 0x00},
+    };
+    htu21d_scheduler_t scheduler;
+    htu21d_reading_t reading;
+
+    mock_port_reset();
+    CHECK_EQ(htu21d_scheduler_init(&scheduler, htu21d_get_default_dev(), channels), HTU21D_ERR_OK);
+    uint64_t start_us = htu21d_port_time_us();
+
+    // both due: humidity first, it is at the current setting (after reading it)
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(reading.channel, HTU21D_CHANNEL_HUMIDITY);
+    CHECK_EQ(reading.flags, HTU21D_SAMPLE_CRC_OK);
+    CHECK_EQ(htu21d_reading_value(&reading) > 54.0F && htu21d_reading_value(&reading) < 56.0F, 1);
+    CHECK_COST(1 + 2, 1 + 1, 1 + 3, 16);
+
+    // then temperature, switching to 11 bits once
+    mock_port_reset();
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(reading.channel, HTU21D_CHANNEL_TEMPERATURE);
+    CHECK_EQ(reading.timestamp_us - start_us, 16000);
+    CHECK_EQ(mock_port_user_register(), 0x83);
+    CHECK_COST(3, 3, 3, 7);
+
+    // nine more on the 100 ms grid, no humidity conversions in between
+    for (int i = 1; i < 10; i++) {
+        mock_port_reset();
+        CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+        CHECK_EQ(reading.channel, HTU21D_CHANNEL_TEMPERATURE);
+        CHECK_EQ(reading.timestamp_us - start_us, i * 100000);
+    }
+    CHECK_COST(2, 1, 3, 100 - 7 + 7);
+
+    // humidity and temperature due together at 1 s: 11 bits still set
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(reading.channel, HTU21D_CHANNEL_TEMPERATURE);
+    CHECK_EQ(reading.timestamp_us - start_us, 1000000);
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(reading.channel, HTU21D_CHANNEL_HUMIDITY);
+    CHECK_EQ(scheduler.overruns, 0);
+
+    // humidity off
+    htu21d_channel_config_t off[HTU21D_CHANNELS] = {{0, 0x00}, {0, 0x00}};
+    CHECK_EQ(htu21d_scheduler_init(&scheduler, htu21d_get_default_dev(), off), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_INVALID_STATE);
+    off[HTU21D_CHANNEL_HUMIDITY].resolution = 0x02;
+    CHECK_EQ(htu21d_scheduler_init(&scheduler, htu21d_get_default_dev(), off), HTU21D_ERR_INVALID_ARG);
+
+    // the heater switched on behind the driver's back stays on when switching
+    htu21d_dev_t *dev = htu21d_get_default_dev();
+    mock_port_reset();
+    htu21d_write_user_register(0x06);
+    dev->user_register = 0x02;
+    CHECK_EQ(htu21d_scheduler_init(&scheduler, dev, channels), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(reading.channel, HTU21D_CHANNEL_TEMPERATURE);
+    CHECK_EQ(mock_port_user_register(), 0x87);
+
+    // failed conversions count towards the circuit breaker
+    mock_port_unplug(true);
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_TIMEOUT);
+    CHECK_EQ(dev->failures, 1);
+    mock_port_unplug(false);
+    CHECK_EQ(htu21d_scheduler_next(&scheduler, &reading), HTU21D_ERR_OK);
+    CHECK_EQ(dev->failures, 0);
+    htu21d_write_user_register(0x02);
+}
+
+static void test_sweep(void)
+{
+    htu21d_dev_t devs[4];
+    htu21d_sweep_result_t results[4];
+
+    // listed alternating between two muxes
+    htu21d_dev_init(&devs[0], 0, 0x70, 0);
+    htu21d_dev_init(&devs[1], 0, 0x71, 0);
+    htu21d_dev_init(&devs[2], 0, 0x70, 1);
+    htu21d_dev_init(&devs[3], 0, 0x71, 1);
+
+    // triggered and fetched mux by mux: 6 channel selects per pass instead of 8
+    mock_port_reset();
+    CHECK_EQ(htu21d_sweep(devs, 4, TRIGGER_TEMP_MEASURE_NOHOLD, results), HTU21D_ERR_OK);
+    CHECK_COST(6 + 4 + 6 + 4, 6 + 4 + 6, 4 * 3, 50);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(results[i].status, HTU21D_ERR_OK);
+        CHECK_EQ(results[i].raw, 0x6658);
+        CHECK_EQ(results[i].skew_us, 0);
+    }
+
+    // a bad CRC only shows in that sensor's result
+    mock_port_reset();
+    mock_port_corrupt_crc(1);
+    CHECK_EQ(htu21d_sweep(devs, 2, TRIGGER_HUMD_MEASURE_NOHOLD, results), HTU21D_ERR_OK);
+    CHECK_EQ(results[0].status, HTU21D_ERR_CRC);
+    CHECK_EQ(results[1].status, HTU21D_ERR_OK);
+    CHECK_EQ(htu21d_sweep(devs, 2, TRIGGER_HUMD_MEASURE_HOLD, results), HTU21D_ERR_INVALID_ARG);
+
+    // a sensor that ACKs the trigger but hangs on the read trips its breaker...
+    mock_port_reset();
+    mock_port_fail_reads(HTU21D_BREAKER_THRESHOLD);
+    for (int i = 0; i < HTU21D_BREAKER_THRESHOLD; i++) {
+        CHECK_EQ(htu21d_sweep(devs, 1, TRIGGER_TEMP_MEASURE_NOHOLD, results), HTU21D_ERR_FAIL);
+        CHECK_EQ(results[0].status, HTU21D_ERR_TIMEOUT);
+        CHECK_EQ(devs[0].pending_command, 0);
+    }
+    CHECK_EQ(devs[0].failures, HTU21D_BREAKER_THRESHOLD);
+
+    // ...and stops costing the sweep its timeout
+    mock_port_reset();
+    CHECK_EQ(htu21d_sweep(devs, 1, TRIGGER_TEMP_MEASURE_NOHOLD, results), HTU21D_ERR_FAIL);
+    CHECK_EQ(results[0].status, HTU21D_ERR_UNAVAILABLE);
+    CHECK_COST(0, 0, 0, 0);
+}
+
+int main(void)
+{
+    test_init();
+    test_read_temperature();
+    test_read_humidity();
+    test_read_value();
+    test_get_resolution();
+    test_set_resolution();
+    test_soft_reset();
+    test_user_register();
+    test_read_modes();
+    test_pipelined();
+    test_sample();
+    test_sample_flags();
+    test_oversampling();
+    test_plan();
+    test_mux();
+    test_queue();
+    test_history();
+    test_downsample();
+    test_governor();
+    test_cache();
+    test_breaker();
+    test_scheduler();
+    test_sweep();
+
+    if (_failures) {
+        fprintf(stderr, "%d check(s) failed\n", _failures);
+        return EXIT_FAILURE;
+    }
+    printf("All transaction count checks passed\n");
+    return EXIT_SUCCESS;
+}
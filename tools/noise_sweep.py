@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Noise versus latency and energy of the HTU21D's resolutions and oversampling.
+
+Analyzes raw code traces recorded on a real sensor by the
+examples/noise_sweep_htu21d firmware (its `trace,<resolution>,<T|RH>,<raw>`
+lines, anything else in the log is ignored). For every resolution, channel and
+oversampling count (averaging 1-16 conversions per reading) it reports:
+
+* noise: standard deviation of one reading in degC or %RH, estimated from the
+  differences of consecutive readings divided by sqrt(2), so slow drift during
+  the recording doesn't count as noise,
+* latency: conversions x the datasheet's maximum conversion time,
+* energy: latency x supply voltage x measuring current (I2C traffic and
+  standby current excluded).
+
+With --max-noise-t/--max-noise-rh it also picks the cheapest (lowest energy)
+configuration per channel that meets the noise spec and, since both channels
+share the user register, the cheapest resolution for a T+RH reading meeting
+both.
+
+Usage: noise_sweep.py [--supply-v V] [--current-ma MA] [--max-noise-t DEGC]
+                      [--max-noise-rh PCT] LOG [LOG...]
+"""
+
+import argparse
+import math
+import sys
+
+# Datasheet maximum conversion times (ms) per user register resolution bits.
+CONVERSION_MS = {
+    "T": {0x00: 50, 0x01: 13, 0x80: 25, 0x81: 7},
+    "RH": {0x00: 16, 0x01: 3, 0x80: 5, 0x81: 8},
+}
+
+BITS = {
+    "T": {0x00: 14, 0x01: 12, 0x80: 13, 0x81: 11},
+    "RH": {0x00: 12, 0x01: 8, 0x80: 10, 0x81: 11},
+}
+
+UNIT = {"T": 175.72 / 65536, "RH": 125.0 / 65536}
+UNIT_NAME = {"T": "degC", "RH": "%RH"}
+
+OVERSAMPLING = [1, 2, 4, 8, 16]
+
+
+def read_traces(paths):
+    """Returns {(resolution, channel): [raw, ...]} from the trace lines."""
+    traces = {}
+    for path in paths:
+        with open(path, encoding="utf-8", errors="replace") as log:
+            for line in log:
+                fields = line.strip().split(",")
+                if len(fields) != 4 or not fields[0].endswith("trace"):
+                    continue
+                try:
+                    key = (int(fields[1], 0), fields[2])
+                    raw = int(fields[3])
+                except ValueError:
+                    continue
+                if key[1] in UNIT and raw != 0:
+                    traces.setdefault(key, []).append(raw)
+    return traces
+
+
+def noise(raw, oversampling):
+    """Noise of the mean of `oversampling` consecutive codes, in code units."""
+    readings = len(raw) // oversampling
+    means = [sum(raw[r * oversampling:(r + 1) * oversampling]) / oversampling
+             for r in range(readings)]
+    diffs = [b - a for a, b in zip(means, means[1:])]
+    if len(diffs) < 2:
+        return None
+    mean = sum(diffs) / len(diffs)
+    variance = sum((d - mean) ** 2 for d in diffs) / (len(diffs) - 1)
+    return math.sqrt(variance / 2)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("logs", nargs="+", metavar="LOG")
+    parser.add_argument("--supply-v", type=float, default=3.0)
+    parser.add_argument("--current-ma", type=float, default=0.45,
+                        help="supply current while measuring (datasheet typical)")
+    parser.add_argument("--max-noise-t", type=float, help="temperature noise spec, degC")
+    parser.add_argument("--max-noise-rh", type=float, help="humidity noise spec, %%RH")
+    args = parser.parse_args()
+
+    traces = read_traces(args.logs)
+    if not traces:
+        print("No trace lines found", file=sys.stderr)
+        return 1
+    spec = {"T": args.max_noise_t, "RH": args.max_noise_rh}
+    cheapest = {}  # (channel, resolution) -> cheapest row meeting the spec
+
+    for channel in ("T", "RH"):
+        rows = []
+        for (resolution, trace_channel), raw in sorted(traces.items()):
+            if trace_channel != channel:
+                continue
+            for oversampling in OVERSAMPLING:
+                sigma = noise(raw, oversampling)
+                if sigma is None:
+                    continue
+                latency_ms = oversampling * CONVERSION_MS[channel][resolution]
+                energy_uj = args.supply_v * args.current_ma * latency_ms
+                rows.append((resolution, oversampling, sigma * UNIT[channel], latency_ms,
+                             energy_uj, len(raw)))
+        if not rows:
+            continue
+
+        print(f"{'Temperature' if channel == 'T' else 'Humidity'} ({UNIT_NAME[channel]})")
+        print(f"{'Resolution':<12} {'Bits':>4} {'Oversampling':>12} {'Noise':>9} "
+              f"{'Latency ms':>10} {'Energy uJ':>10} {'Samples':>8}")
+        for resolution, oversampling, sigma, latency_ms, energy_uj, samples in rows:
+            print(f"0x{resolution:02X}{'':<8} {BITS[channel][resolution]:>4} {oversampling:>12} "
+                  f"{sigma:>9.4f} {latency_ms:>10} {energy_uj:>10.1f} {samples:>8}")
+
+        if spec[channel] is not None:
+            meeting = [row for row in rows if row[2] <= spec[channel]]
+            for row in sorted(meeting, key=lambda row: -row[4]):
+                cheapest[(channel, row[0])] = row
+            if meeting:
+                best = min(meeting, key=lambda row: (row[4], row[2]))
+                print(f"Cheapest under {spec[channel]} {UNIT_NAME[channel]}: resolution "
+                      f"0x{best[0]:02X} x{best[1]} ({best[2]:.4f} {UNIT_NAME[channel]}, "
+                      f"{best[3]} ms, {best[4]:.1f} uJ)")
+            else:
+                print(f"No configuration meets {spec[channel]} {UNIT_NAME[channel]}")
+        print()
+
+    if spec["T"] is not None and spec["RH"] is not None:
+        pairs = [(cheapest[("T", resolution)], cheapest[("RH", resolution)])
+                 for resolution in CONVERSION_MS["T"]
+                 if ("T", resolution) in cheapest and ("RH", resolution) in cheapest]
+        if pairs:
+            t, rh = min(pairs, key=lambda pair: pair[0][4] + pair[1][4])
+            print(f"Cheapest T+RH reading: resolution 0x{t[0]:02X}, T x{t[1]}, RH x{rh[1]} "
+                  f"({t[3] + rh[3]} ms, {t[4] + rh[4]:.1f} uJ)")
+        else:
+            print("No single resolution meets both specs")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
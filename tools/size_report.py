@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Code size and stack footprint of the HTU21D driver per feature configuration.
+
+Compiles the component (all its modules) once per configuration below with size flags
+(-Os -ffunction-sections -fdata-sections, like an ESP-IDF release build) and
+reports, for each one:
+
+* .text/.rodata/.data/.bss contributions,
+* libm functions the objects import (e.g. exp2f/log10f for the dew point),
+* the worst-case stack depth of every public entry point, from the static
+  call graph GCC emits with -fcallgraph-info=su. Calls leaving the component
+  (libc, libm, the RTOS) are counted as 0 bytes and marked with '*'.
+
+The host compiler gives host numbers; pass --cc for a cross compiler (e.g.
+xtensa-esp32-elf-gcc) to get target numbers. The Linux port is only included
+when it compiles for the given compiler.
+
+Usage: size_report.py [--cc CC] [--size SIZE] [--nm NM] [--out-dir DIR]
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+SOURCE_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# (name, description, Kconfig options)
+CONFIGS = [
+    ("minimal", "no derived math, no logging, no spectrum",
+     {"CONFIG_HTU21D_DERIVED_MATH": 0, "CONFIG_HTU21D_LOGGING": 0, "CONFIG_HTU21D_SPECTRUM": 0}),
+    ("math", "minimal + derived math",
+     {"CONFIG_HTU21D_DERIVED_MATH": 1, "CONFIG_HTU21D_LOGGING": 0, "CONFIG_HTU21D_SPECTRUM": 0}),
+    ("logging", "minimal + logging",
+     {"CONFIG_HTU21D_DERIVED_MATH": 0, "CONFIG_HTU21D_LOGGING": 1, "CONFIG_HTU21D_SPECTRUM": 0}),
+    ("spectrum", "minimal + spectrum",
+     {"CONFIG_HTU21D_DERIVED_MATH": 0, "CONFIG_HTU21D_LOGGING": 0, "CONFIG_HTU21D_SPECTRUM": 1}),
+    ("full", "derived math + logging + spectrum (default)",
+     {"CONFIG_HTU21D_DERIVED_MATH": 1, "CONFIG_HTU21D_LOGGING": 1, "CONFIG_HTU21D_SPECTRUM": 1}),
+]
+
+# Every module the component compiles, like HTU21D_CORE_SOURCES in CMakeLists.txt.
+CORE_SOURCES = sorted(name for name in os.listdir(SOURCE_DIR)
+                      if name.startswith("htu21d") and name.endswith(".c"))
+PORT_SOURCES = ["port/htu21d_port_linux.c"]
+
+SECTIONS = [
+    ("text", (".text", ".literal", ".iram")),
+    ("rodata", (".rodata", ".srodata")),
+    ("data", (".data", ".sdata")),
+    ("bss", (".bss", ".sbss")),
+]
+
+LIBM = {
+    "pow", "powf", "log", "logf", "log10", "log10f", "exp", "expf", "sqrt",
+    "sqrtf", "floor", "floorf", "ceil", "ceilf", "fabs", "fabsf", "round",
+    "roundf", "lround", "lroundf", "sin", "sinf", "cos", "cosf", "atan",
+    "atanf", "atan2", "atan2f", "exp10", "exp10f", "exp2", "exp2f",
+}
+
+NODE_RE = re.compile(r'node: \{ title: "([^"]+)" label: "[^"]*?(?:\\n(\d+) bytes \([^)]*\))?"')
+EDGE_RE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+
+
+def compile_config(args, name, options):
+    out_dir = os.path.join(args.out_dir, name)
+    os.makedirs(out_dir, exist_ok=True)
+    objects = []
+    for source in CORE_SOURCES + PORT_SOURCES:
+        obj = os.path.join(out_dir, os.path.basename(source).replace(".c", ".o"))
+        cmd = [args.cc, "-Os", "-ffunction-sections", "-fdata-sections",
+               "-fstack-usage", "-fcallgraph-info=su",
+               "-I" + SOURCE_DIR, "-I" + os.path.join(SOURCE_DIR, "port"),
+               "-c", os.path.join(SOURCE_DIR, source), "-o", obj]
+        cmd += ["-D%s=%d" % item for item in options.items()]
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        if result.returncode != 0:
+            if source in CORE_SOURCES:
+                sys.exit("Failed to compile %s:\n%s" % (source, result.stderr))
+            continue
+        objects.append(obj)
+    return objects
+
+
+def section_sizes(args, objects):
+    sizes = {key: 0 for key, _ in SECTIONS}
+    for obj in objects:
+        output = subprocess.run([args.size, "-A", "-d", obj], capture_output=True,
+                                text=True, check=True).stdout
+        for line in output.splitlines():
+            fields = line.split()
+            if len(fields) < 2 or not fields[1].isdigit():
+                continue
+            for key, prefixes in SECTIONS:
+                if fields[0].startswith(prefixes):
+                    sizes[key] += int(fields[1])
+    return sizes
+
+
+def libm_imports(args, objects):
+    imports = set()
+    for obj in objects:
+        output = subprocess.run([args.nm, "-u", obj], capture_output=True,
+                                text=True, check=True).stdout
+        imports.update(line.split()[-1] for line in output.splitlines() if line.strip())
+    return sorted(imports & LIBM)
+
+
+def stack_depths(objects):
+    """Worst-case stack of every function defined in the objects."""
+    frames, calls = {}, {}
+    for obj in objects:
+        with open(obj[:-2] + ".ci") as ci:
+            for line in ci:
+                node = NODE_RE.match(line)
+                if node and node.group(2) is not None:
+                    frames[node.group(1)] = int(node.group(2))
+                edge = EDGE_RE.match(line)
+                if edge:
+                    calls.setdefault(edge.group(1), set()).add(edge.group(2))
+
+    depths = {}
+
+    def depth(function, visiting):
+        if function in depths:
+            return depths[function]
+        if function not in frames or function in visiting:
+            # leaves the component (or recursion, which the driver has none of)
+            return 0, True
+        visiting.add(function)
+        worst, external = 0, False
+        for callee in calls.get(function, ()):
+            callee_depth, callee_external = depth(callee, visiting)
+            worst = max(worst, callee_depth)
+            external = external or callee_external
+        visiting.discard(function)
+        depths[function] = (frames[function] + worst, external)
+        return depths[function]
+
+    for function in frames:
+        depth(function, set())
+    return depths
+
+
+def public_functions():
+    functions = []
+    for source in CORE_SOURCES:
+        with open(os.path.join(SOURCE_DIR, source[:-2] + ".h")) as header:
+            functions += re.findall(r"^\w[\w\s\*]*?\b(\w+)\(", header.read(), re.MULTILINE)
+    return functions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--cc", default="cc")
+    parser.add_argument("--size", default="size")
+    parser.add_argument("--nm", default="nm")
+    parser.add_argument("--out-dir", default="size_report")
+    args = parser.parse_args()
+
+    results = []
+    for name, description, options in CONFIGS:
+        objects = compile_config(args, name, options)
+        results.append((name, description, section_sizes(args, objects),
+                        libm_imports(args, objects), stack_depths(objects)))
+
+    print("HTU21D footprint per configuration (%s, -Os)\n" % args.cc)
+    libm_width = max([len("libm imports")] + [len(", ".join(result[3])) for result in results])
+    print("%-8s %7s %7s %7s %7s  %-*s %s" % ("Config", ".text", ".rodata", ".data", ".bss",
+                                             libm_width, "libm imports", "Description"))
+    for name, description, sizes, libm, _ in results:
+        print("%-8s %7d %7d %7d %7d  %-*s %s" % (name, sizes["text"], sizes["rodata"],
+                                                 sizes["data"], sizes["bss"], libm_width,
+                                                 ", ".join(libm) or "-", description))
+
+    print("\nWorst-case stack per public function (bytes)\n")
+    print("%-40s" % "Function" + "".join("%10s" % result[0] for result in results))
+    for function in public_functions():
+        row = "%-40s" % function
+        for result in results:
+            depth = result[4].get(function)
+            row += "%10s" % ("-" if depth is None else "%d%s" % (depth[0], "*" if depth[1] else " "))
+        print(row)
+    print("\n* also calls outside the component (libc/libm/RTOS), counted as 0 bytes")
+
+
+if __name__ == "__main__":
+    main()